@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <time.h>
+#include <stdlib.h>
+#include <string.h>
+#include "zstr.h"
+
+#define COUNT  (1 << 20)    // 1 Million strings, 50/50 short/long.
+#define ROUNDS 50
+
+static double now() 
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Reference accessors: branch on the layout flag like a naive SSO string would.
+// Both loops are kept out of line so every round really walks the array.
+#if defined(__GNUC__) || defined(__clang__)
+    #define BENCH_NOINLINE __attribute__((noinline))
+#else
+    #define BENCH_NOINLINE
+#endif
+
+static BENCH_NOINLINE size_t branchy_sum(const zstr *arr, size_t n)
+{
+    size_t sum = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        const zstr *s = &arr[i];
+        if (zstr_is_long(s))
+        {
+            sum += s->l.len + (unsigned char)s->l.ptr[0];
+        }
+        else
+        {
+            sum += s->s.len + (unsigned char)s->s.buf[0];
+        }
+    }
+    return sum;
+}
+
+static BENCH_NOINLINE size_t accessor_sum(const zstr *arr, size_t n)
+{
+    size_t sum = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        sum += zstr_len(&arr[i]) + (unsigned char)zstr_cstr(&arr[i])[0];
+    }
+    return sum;
+}
+
+int main(void)
+{
+    zstr *arr = malloc(sizeof(zstr) * COUNT);
+    if (!arr) return 1;
+
+    // Random mix so the short/long branch cannot be predicted.
+    srand(42);
+    for (size_t i = 0; i < COUNT; i++)
+    {
+        arr[i] = (rand() & 1) ? zstr_from("a string that lives on the heap")
+                              : zstr_from("short");
+    }
+
+    printf("=> Accessors over %d strings (50/50 short/long), %d rounds\n", COUNT, ROUNDS);
+
+    volatile size_t sink = 0;
+    double start = now();
+    for (int r = 0; r < ROUNDS; r++) sink += branchy_sum(arr, COUNT);
+    printf("[Branchy] Time: %.4fs (Sum: %zu)\n", now() - start, (size_t)sink);
+
+    sink = 0;
+    start = now();
+    for (int r = 0; r < ROUNDS; r++) sink += accessor_sum(arr, COUNT);
+    printf("[zstr]    Time: %.4fs (Sum: %zu)\n", now() - start, (size_t)sink);
+
+    for (size_t i = 0; i < COUNT; i++) zstr_free(&arr[i]);
+    free(arr);
+    return 0;
+}
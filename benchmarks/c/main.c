@@ -61,7 +61,7 @@ void bench_append_zstr()
         zstr_push(&s, 'A');
     }
     
-    printf("[zstr Append] Time: %.4fs (Cap: %zu)\n", now() - start, s.is_long ? s.l.cap : 23);
+    printf("[zstr Append] Time: %.4fs (Cap: %zu)\n", now() - start, zstr_capacity(&s));
     zstr_free(&s);
 }
 
@@ -7,6 +7,8 @@
 #include "zstr.h"
 
 #define ZSTR_LUA_MT "zstr_mt"
+#define ZSTR_LUA_MATCHER_MT "zstr_matcher_mt"
+#define ZSTR_LUA_LINES_MT "zstr_lines_mt"
 
 /* For compatibility. */
 
@@ -38,6 +40,11 @@ static zstr* check_zstr(lua_State *L, int index)
     return (zstr*)luaL_checkudata(L, index, ZSTR_LUA_MT);
 }
 
+static zstr_matcher* check_matcher(lua_State *L, int index) 
+{
+    return (zstr_matcher*)luaL_checkudata(L, index, ZSTR_LUA_MATCHER_MT);
+}
+
 static zstr* push_new_zstr(lua_State *L) 
 {
     zstr *s = (zstr*)lua_newuserdata(L, sizeof(zstr));
@@ -107,8 +114,8 @@ static int l_zstr_append(lua_State *L)
         size_t current_len = zstr_len(s);
         size_t required = current_len + total_add_len;
         
-        size_t cap = s->is_long ? s->l.cap : ZSTR_SSO_CAP;
-        if (required > cap) 
+        size_t cap = zstr_capacity(s);
+        if (required >= cap) 
         {
              zstr_reserve(s, required);
         }
@@ -127,8 +134,7 @@ static int l_zstr_append(lua_State *L)
         }
         
         *ptr = '\0';
-        if (s->is_long) s->l.len += total_add_len;
-        else s->s.len += (uint8_t)total_add_len;
+        zstr__set_len(s, zstr_len(s) + total_add_len);
     }
 
     lua_pushvalue(L, 1);
@@ -160,8 +166,8 @@ static int l_zstr_append_table(lua_State *L)
         size_t current_len = zstr_len(s);
         size_t required = current_len + total_add_len;
         
-        size_t cap = s->is_long ? s->l.cap : ZSTR_SSO_CAP;
-        if (required > cap) 
+        size_t cap = zstr_capacity(s);
+        if (required >= cap) 
         {
              zstr_reserve(s, required);
         }
@@ -182,8 +188,7 @@ static int l_zstr_append_table(lua_State *L)
         }
         
         *ptr = '\0';
-        if (s->is_long) s->l.len += total_add_len;
-        else s->s.len += (uint8_t)total_add_len;
+        zstr__set_len(s, zstr_len(s) + total_add_len);
     }
 
     lua_pushvalue(L, 1);
@@ -247,9 +252,10 @@ static int l_zstr_upper(lua_State *L)
 static int l_zstr_replace(lua_State *L) 
 {
     zstr *s = check_zstr(L, 1);
-    const char *tgt = luaL_checkstring(L, 2);
-    const char *repl = luaL_checkstring(L, 3);
-    zstr_replace(s, tgt, repl);
+    size_t tgt_len, repl_len;
+    const char *tgt = luaL_checklstring(L, 2, &tgt_len);
+    const char *repl = luaL_checklstring(L, 3, &repl_len);
+    zstr_replace_len(s, tgt, tgt_len, repl, repl_len);
     return 0;
 }
 
@@ -259,8 +265,9 @@ static int l_zstr_replace(lua_State *L)
 static int l_zstr_contains(lua_State *L) 
 {
     zstr *s = check_zstr(L, 1);
-    const char *needle = luaL_checkstring(L, 2);
-    lua_pushboolean(L, zstr_contains(s, needle));
+    size_t len;
+    const char *needle = luaL_checklstring(L, 2, &len);
+    lua_pushboolean(L, zstr_find_len(s, needle, len) != -1);
     return 1;
 }
 
@@ -268,8 +275,9 @@ static int l_zstr_contains(lua_State *L)
 static int l_zstr_find(lua_State *L) 
 {
     zstr *s = check_zstr(L, 1);
-    const char *needle = luaL_checkstring(L, 2);
-    ptrdiff_t idx = zstr_find(s, needle);
+    size_t len;
+    const char *needle = luaL_checklstring(L, 2, &len);
+    ptrdiff_t idx = zstr_find_len(s, needle, len);
     if (idx < 0) lua_pushnil(L);
     else lua_pushinteger(L, idx + 1);
     return 1;
@@ -312,8 +320,7 @@ static int l_zstr_is_empty(lua_State *L)
 static int l_zstr_capacity(lua_State *L) 
 {
     zstr *s = check_zstr(L, 1);
-    size_t cap = s->is_long ? s->l.cap : ZSTR_SSO_CAP;
-    lua_pushinteger(L, cap);
+    lua_pushinteger(L, zstr_capacity(s));
     return 1;
 }
 
@@ -321,23 +328,167 @@ static int l_zstr_capacity(lua_State *L)
 static int l_zstr_split(lua_State *L) 
 {
     zstr *s = check_zstr(L, 1);
-    const char *delim = luaL_checkstring(L, 2);
+    size_t delim_len;
+    const char *delim = luaL_checklstring(L, 2, &delim_len);
     
+    zstr_view v = zstr_as_view(s);
+    zstr_view d = { delim, delim_len };
+
+    // Count once so the table and the field array are sized up front.
+    zstr_view stack_parts[64];
+    zstr_view *parts = stack_parts;
+    size_t n = zstr_split_count(v, d);
+    if (n > 64) parts = (zstr_view*)lua_newuserdata(L, n * sizeof(zstr_view));
+
+    zstr_split_into(v, d, parts, n);
+
+    lua_createtable(L, (int)n, 0);
+    for (size_t i = 0; i < n; i++) 
+    {
+        lua_pushlstring(L, parts[i].data, parts[i].len);
+        lua_rawseti(L, -2, (lua_Integer)i + 1);
+    }
+    return 1;
+}
+
+/* Multi-pattern matching. */
+
+// zstr.matcher({"pat1", "pat2", ...}) -> matcher
+static int l_zstr_matcher_new(lua_State *L) 
+{
+    luaL_checktype(L, 1, LUA_TTABLE);
+    size_t n = lua_rawlen(L, 1);
+
+    // Scratch array owned by the GC; the strings stay alive through the table.
+    zstr_view *pats = (zstr_view*)lua_newuserdata(L, (n + 1) * sizeof(zstr_view));
+    for (size_t i = 1; i <= n; i++) 
+    {
+        lua_rawgeti(L, 1, i);
+        luaL_argcheck(L, lua_type(L, -1) == LUA_TSTRING, 1, "patterns must be strings");
+        pats[i - 1].data = lua_tolstring(L, -1, &pats[i - 1].len);
+        lua_pop(L, 1);
+    }
+
+    zstr_matcher *m = (zstr_matcher*)lua_newuserdata(L, sizeof(zstr_matcher));
+    memset(m, 0, sizeof(zstr_matcher));
+    luaL_getmetatable(L, ZSTR_LUA_MATCHER_MT);
+    lua_setmetatable(L, -2);
+
+    switch (zstr_matcher_init(m, pats, n))
+    {
+        case Z_OK:     return 1;
+        case Z_EINVAL: return luaL_argerror(L, 1, "too many patterns or pattern bytes");
+        default:       return luaL_error(L, "zstr.matcher: out of memory");
+    }
+}
+
+static int l_zstr_matcher_gc(lua_State *L) 
+{
+    zstr_matcher_free(check_matcher(L, 1));
+    return 0;
+}
+
+// s:match_all(matcher) -> { {id = i, pos = p}, ... } (1-based pattern ids and positions)
+static int l_zstr_match_all(lua_State *L) 
+{
+    zstr *s = check_zstr(L, 1);
+    zstr_matcher *m = check_matcher(L, 2);
+
     lua_newtable(L);
     int idx = 1;
-    
-    zstr_view v = zstr_as_view(s);
-    zstr_split_iter it = zstr_split_init(v, delim);
-    zstr_view part;
-    
-    while(zstr_split_next(&it, &part)) 
+
+    zstr_matcher_iter it = zstr_matcher_iter_init(m, zstr_as_view(s));
+    zstr_match match;
+
+    while (zstr_matcher_next(&it, &match)) 
     {
-        lua_pushlstring(L, part.data, part.len);
+        lua_createtable(L, 0, 2);
+        lua_pushinteger(L, (lua_Integer)match.id + 1);
+        lua_setfield(L, -2, "id");
+        lua_pushinteger(L, (lua_Integer)match.start + 1);
+        lua_setfield(L, -2, "pos");
         lua_rawseti(L, -2, idx++);
     }
     return 1;
 }
 
+// s:match_any(matcher) -> bool
+static int l_zstr_match_any(lua_State *L) 
+{
+    zstr *s = check_zstr(L, 1);
+    zstr_matcher *m = check_matcher(L, 2);
+    lua_pushboolean(L, zstr_matcher_contains(m, zstr_as_view(s)));
+    return 1;
+}
+
+/* Streaming line reader. */
+
+#if defined(ZSTR_HAS_POSIX)
+
+// Reader plus the fd it opened (closed by the iterator at EOF or by __gc).
+typedef struct {
+    zstr_line_reader r;
+    int fd;
+} zstr_lua_lines;
+
+static void lines_close(zstr_lua_lines *ud)
+{
+    zstr_line_reader_free(&ud->r);
+    if (ud->fd >= 0) close(ud->fd);
+    ud->fd = -1;
+}
+
+static int l_zstr_lines_gc(lua_State *L) 
+{
+    lines_close((zstr_lua_lines*)luaL_checkudata(L, 1, ZSTR_LUA_LINES_MT));
+    return 0;
+}
+
+static int l_zstr_lines_step(lua_State *L) 
+{
+    zstr_lua_lines *ud = (zstr_lua_lines*)lua_touserdata(L, lua_upvalueindex(1));
+    if (ud->fd < 0) return 0;
+
+    zstr_view line;
+    if (zstr_line_reader_next(&ud->r, &line)) 
+    {
+        lua_pushlstring(L, line.data, line.len);
+        return 1;
+    }
+
+    int err = zstr_line_reader_error(&ud->r);
+    lines_close(ud);
+    if (err) return luaL_error(L, "zstr.lines: read failed (errno %d)", err);
+    return 0;
+}
+
+// zstr.lines(path, optional_block_size) -> iterator over the lines (without '\n')
+static int l_zstr_lines(lua_State *L) 
+{
+    const char *path = luaL_checkstring(L, 1);
+    lua_Integer block = luaL_optinteger(L, 2, 0);
+    luaL_argcheck(L, block >= 0, 2, "block size must be >= 0");
+
+    zstr_lua_lines *ud = (zstr_lua_lines*)lua_newuserdata(L, sizeof(zstr_lua_lines));
+    memset(ud, 0, sizeof(*ud));
+    ud->fd = -1;
+    luaL_getmetatable(L, ZSTR_LUA_LINES_MT);
+    lua_setmetatable(L, -2);
+
+    ud->fd = open(path, O_RDONLY);
+    if (ud->fd < 0) return luaL_error(L, "zstr.lines: cannot open %s", path);
+    if (zstr_line_reader_init(&ud->r, ud->fd, (size_t)block) != Z_OK) 
+    {
+        lines_close(ud);
+        return luaL_error(L, "zstr.lines: out of memory");
+    }
+
+    lua_pushcclosure(L, l_zstr_lines_step, 1);
+    return 1;
+}
+
+#endif
+
 /* Metamethods. */
 
 static int l_zstr_tostring(lua_State *L) 
@@ -408,6 +559,10 @@ static const luaL_Reg zstr_methods[] = {
     // Lifecycle.
     {"new",         l_zstr_new},
     {"from_file",   l_zstr_from_file},
+#if defined(ZSTR_HAS_POSIX)
+    {"lines",       l_zstr_lines},
+#endif
+    {"matcher",     l_zstr_matcher_new},
     {"clone",       l_zstr_clone},
     
     // Buffer.
@@ -436,6 +591,8 @@ static const luaL_Reg zstr_methods[] = {
     
     // Utils.
     {"split",       l_zstr_split},
+    {"match_all",   l_zstr_match_all},
+    {"match_any",   l_zstr_match_any},
 
     // Meta.
     {"__gc",        l_zstr_gc},
@@ -449,6 +606,18 @@ static const luaL_Reg zstr_methods[] = {
 
 static inline int zstr_register_lib(lua_State *L) 
 {
+    luaL_newmetatable(L, ZSTR_LUA_MATCHER_MT);
+    lua_pushcfunction(L, l_zstr_matcher_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_pop(L, 1);
+
+#if defined(ZSTR_HAS_POSIX)
+    luaL_newmetatable(L, ZSTR_LUA_LINES_MT);
+    lua_pushcfunction(L, l_zstr_lines_gc);
+    lua_setfield(L, -2, "__gc");
+    lua_pop(L, 1);
+#endif
+
     luaL_newmetatable(L, ZSTR_LUA_MT);
     lua_pushvalue(L, -1);
     lua_setfield(L, -2, "__index");
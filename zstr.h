@@ -157,7 +157,69 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <ctype.h>
-#include <stdlib.h> 
+#include <stdlib.h>
+
+// SIMD support (x86 only for now). Define ZSTR_NO_SIMD to force the scalar paths.
+// SSE2 is picked at compile time; AVX2 is either enabled by the compiler flags
+// or dispatched at runtime through `__builtin_cpu_supports` on GCC/Clang.
+#if !defined(ZSTR_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86))
+    #if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+        #define ZSTR_HAS_SSE2 1
+        #include <emmintrin.h>
+    #endif
+    #if defined(__AVX2__)
+        #define ZSTR_HAS_AVX2 1
+        #include <immintrin.h>
+    #elif (defined(__GNUC__) || defined(__clang__)) && !defined(__TINYC__) && defined(ZSTR_HAS_SSE2)
+        #define ZSTR_HAS_AVX2 1
+        #define ZSTR_AVX2_DISPATCH 1
+        #include <immintrin.h>
+    #endif
+#endif
+
+// POSIX file helpers (writev output, mapped files). Define ZSTR_NO_POSIX to leave them out.
+#if !defined(ZSTR_NO_POSIX) && (defined(__unix__) || defined(__APPLE__))
+    #define ZSTR_HAS_POSIX 1
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <limits.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <sys/uio.h>
+#endif
+
+// Worker threads for zstr_read_files. Define ZSTR_NO_THREADS to load files on the
+// calling thread only (glibc before 2.34 needs -pthread otherwise).
+#if defined(ZSTR_HAS_POSIX) && !defined(ZSTR_NO_THREADS) && !defined(ZSTR_NO_ATOMICS) && \
+    (defined(__GNUC__) || defined(__clang__)) && !defined(__TINYC__)
+    #define ZSTR_HAS_THREADS 1
+    #include <pthread.h>
+#endif
+
+// io_uring backend for zstr_read_files (Linux 5.6+, raw syscalls, no liburing).
+// Needs syscall() from <unistd.h>, which strict ISO modes hide. Define
+// ZSTR_NO_IO_URING to always use the thread pool.
+#if defined(ZSTR_HAS_POSIX) && defined(__linux__) && !defined(ZSTR_NO_IO_URING) && defined(__has_include)
+    #if __has_include(<linux/io_uring.h>) && (defined(__USE_MISC) || defined(_DEFAULT_SOURCE) || defined(_GNU_SOURCE))
+        #include <sys/syscall.h>
+        #include <linux/io_uring.h>
+        #include <linux/stat.h>
+        #if defined(__NR_io_uring_setup) && defined(IORING_FEAT_CUR_PERSONALITY)
+            #define ZSTR_HAS_IO_URING 1
+        #endif
+    #endif
+#endif
+
+#if defined(ZSTR_AVX2_DISPATCH)
+    #define ZSTR_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+    #define ZSTR_TARGET_AVX2
+#endif
+
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
 
 // I am thinking of you too, C++ devs.
 #ifdef __cplusplus
@@ -194,6 +256,104 @@ extern "C" {
 #define ZSTR_SSO_CAP 23
 #define ZSTR_UTF8_INVALID 0xFFFD
 
+// Allocator of a string's heap buffer (zstr.alloc). Values 1..ZSTR_MAX_ALLOCATORS
+// are runtime allocators returned by zstr_allocator_register.
+#define ZSTR_ALLOC_HEAP  0      // Z_STR_MALLOC / Z_STR_REALLOC / Z_STR_FREE.
+#define ZSTR_ALLOC_ARENA 0xFF   // Bump-allocated from a zstr_arena; never freed individually.
+
+// Number of runtime allocator slots (must stay below ZSTR_ALLOC_ARENA).
+#ifndef ZSTR_MAX_ALLOCATORS
+    #define ZSTR_MAX_ALLOCATORS 16
+#endif
+
+#ifndef ZSTR_THREAD_LOCAL
+    #if defined(__cplusplus)
+        #define ZSTR_THREAD_LOCAL thread_local
+    #elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+        #define ZSTR_THREAD_LOCAL _Thread_local
+    #elif defined(_MSC_VER)
+        #define ZSTR_THREAD_LOCAL __declspec(thread)
+    #elif defined(__GNUC__) || defined(__clang__)
+        #define ZSTR_THREAD_LOCAL __thread
+    #else
+        #define ZSTR_THREAD_LOCAL
+    #endif
+#endif
+
+// ZSTR_COMPACT: 24-byte zstr with the long/short flag stored in-band (64-bit only).
+// Byte 23 is the SSO length for short strings; for long strings it holds
+// 0x80 | allocator index and shares its word with the capacity (max 2^56 - 1).
+#if defined(ZSTR_COMPACT)
+    #if !defined(SIZE_MAX) || SIZE_MAX != UINT64_MAX
+        #error "ZSTR_COMPACT requires a 64-bit size_t."
+    #endif
+    #if ZSTR_MAX_ALLOCATORS >= 0x7F
+        #error "ZSTR_COMPACT stores the allocator index in 7 bits."
+    #endif
+    #if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        #define ZSTR__CAP_SHIFT 8   // Tag in the low byte of the capacity word.
+    #else
+        #define ZSTR__CAP_SHIFT 0   // Tag in the high byte of the capacity word.
+    #endif
+    #define ZSTR__CAP_MASK  (((uint64_t)1 << 56) - 1)
+    #define ZSTR__LONG_FLAG 0x80
+#endif
+
+// Default block size of a zstr_arena.
+#ifndef ZSTR_ARENA_BLOCK_SIZE
+    #define ZSTR_ARENA_BLOCK_SIZE (64 * 1024)
+#endif
+
+// Reference count updates for zstr_shared, and relaxed accesses to the cached hash
+// (ZSTR_CACHE_HASH). Define ZSTR_NO_ATOMICS for single-threaded builds; compilers without GCC/MSVC atomics fall back to plain updates as well.
+#if !defined(ZSTR_NO_ATOMICS) && defined(_MSC_VER) && !defined(__clang__)
+    #if defined(_WIN64)
+        #define ZSTR__ATOMIC_INC(p) ((size_t)_InterlockedIncrement64((volatile __int64 *)(p)))
+        #define ZSTR__ATOMIC_DEC(p) ((size_t)_InterlockedDecrement64((volatile __int64 *)(p)))
+    #else
+        #define ZSTR__ATOMIC_INC(p) ((size_t)_InterlockedIncrement((volatile long *)(p)))
+        #define ZSTR__ATOMIC_DEC(p) ((size_t)_InterlockedDecrement((volatile long *)(p)))
+    #endif
+    #define ZSTR__ATOMIC_LOAD(p) (*(volatile size_t *)(p))
+    #define ZSTR__RELAXED_LOAD64(p)     ((uint64_t)__iso_volatile_load64((const volatile __int64 *)(p)))
+    #define ZSTR__RELAXED_STORE64(p, v) __iso_volatile_store64((volatile __int64 *)(p), (__int64)(v))
+#elif !defined(ZSTR_NO_ATOMICS) && (defined(__GNUC__) || defined(__clang__)) && !defined(__TINYC__)
+    #define ZSTR__ATOMIC_INC(p)  __atomic_add_fetch((p), 1, __ATOMIC_RELAXED)
+    #define ZSTR__ATOMIC_DEC(p)  __atomic_sub_fetch((p), 1, __ATOMIC_ACQ_REL)
+    #define ZSTR__ATOMIC_LOAD(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+    #define ZSTR__RELAXED_LOAD64(p)     __atomic_load_n((p), __ATOMIC_RELAXED)
+    #define ZSTR__RELAXED_STORE64(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#else
+    #define ZSTR__ATOMIC_INC(p)  (++*(p))
+    #define ZSTR__ATOMIC_DEC(p)  (--*(p))
+    #define ZSTR__ATOMIC_LOAD(p) (*(p))
+    #define ZSTR__RELAXED_LOAD64(p)     (*(p))
+    #define ZSTR__RELAXED_STORE64(p, v) (*(p) = (v))
+#endif
+
+// Spinlock for the shards of a thread-safe zstr_intern pool.
+#if !defined(ZSTR_NO_ATOMICS) && defined(_MSC_VER) && !defined(__clang__)
+    #define ZSTR__SPIN_LOCK(l)   while (_InterlockedExchange((volatile long *)(l), 1)) { ZSTR__SPIN_PAUSE(); }
+    #define ZSTR__SPIN_UNLOCK(l) _InterlockedExchange((volatile long *)(l), 0)
+#elif !defined(ZSTR_NO_ATOMICS) && (defined(__GNUC__) || defined(__clang__)) && !defined(__TINYC__)
+    #define ZSTR__SPIN_LOCK(l)   while (__atomic_exchange_n((l), 1, __ATOMIC_ACQUIRE)) { ZSTR__SPIN_PAUSE(); }
+    #define ZSTR__SPIN_UNLOCK(l) __atomic_store_n((l), 0, __ATOMIC_RELEASE)
+#else
+    #define ZSTR__SPIN_LOCK(l)   ((void)(l))
+    #define ZSTR__SPIN_UNLOCK(l) ((void)(l))
+#endif
+
+#if defined(ZSTR_HAS_SSE2)
+    #define ZSTR__SPIN_PAUSE() _mm_pause()
+#else
+    #define ZSTR__SPIN_PAUSE() ((void)0)
+#endif
+
+// Needles longer than this are searched with Two-Way instead of the SIMD byte filter.
+#ifndef ZSTR_TWOWAY_THRESHOLD
+    #define ZSTR_TWOWAY_THRESHOLD 64
+#endif
+
 #ifndef ZSTR_FMT
 #define ZSTR_FMT "%.*s"
 #define ZSTR_ARG(s) (int)zstr_len(&(s)), zstr_cstr(&(s))
@@ -210,7 +370,14 @@ typedef struct
 {
     char   *ptr;
     size_t len;
+#if defined(ZSTR_COMPACT)
+    size_t cap_tag; // Capacity + in-band tag, use zstr__cap / zstr__set_cap.
+#else
     size_t cap;
+#endif
+#if defined(ZSTR_CACHE_HASH)
+    uint64_t hash;  // Cached zstr_hash (0 = not computed). Lies past the SSO bytes.
+#endif
 } zstr_long;
 
 // Stack allocated (SSO) layout.
@@ -220,14 +387,60 @@ typedef struct {
 } zstr_short;
 
 // The main string type.
+#if defined(ZSTR_COMPACT)
+typedef struct {
+    union {
+        zstr_long l;
+        zstr_short s;
+    };
+} zstr;
+#else
 typedef struct {
     uint8_t is_long;
-    char _pad[7];   // Padding for alignment on 64-bit systems.
+    uint8_t alloc;  // Allocator of the heap buffer (ZSTR_ALLOC_* or a registered index).
+    char _pad[6];   // Padding for alignment on 64-bit systems.
     union {
         zstr_long l;
         zstr_short s;
     };
 } zstr;
+#endif
+
+// Runtime allocator. Sizes passed to realloc_fn/free_fn are the ones the buffer
+// was requested with. realloc_fn is optional (NULL = alloc + copy + free).
+typedef struct {
+    void *(*alloc_fn)(void *ctx, size_t size);
+    void *(*realloc_fn)(void *ctx, void *ptr, size_t old_size, size_t new_size);
+    void  (*free_fn)(void *ctx, void *ptr, size_t size);
+    void  *ctx;
+} zstr_allocator;
+
+// Arena block header; the block's data follows it in the same allocation.
+typedef struct zstr_arena_block {
+    struct zstr_arena_block *next;
+    size_t cap;
+    size_t used;
+} zstr_arena_block;
+
+// Bump allocator for batches of short-lived strings. Everything allocated from
+// it is released at once by zstr_arena_reset / zstr_arena_free.
+typedef struct {
+    zstr_arena_block *head;
+    size_t block_size;
+    size_t reserved;        // Total bytes of block data obtained from the heap.
+} zstr_arena;
+
+// Header of a shared string block; the bytes and a null terminator follow it.
+typedef struct {
+    size_t refs;    // Reference count (updated atomically).
+    size_t len;
+    uint8_t alloc;  // Allocator the block came from.
+} zstr_shared_hdr;
+
+// Immutable reference-counted string. Copies share one block (zstr_shared_retain).
+typedef struct {
+    zstr_shared_hdr *h; // NULL for the empty string.
+} zstr_shared;
 
 // A read-only slice of a string (borrowed reference).
 typedef struct
@@ -236,6 +449,32 @@ typedef struct
     size_t len;
 } zstr_view;
 
+// Growable array of views (filled by zstr_split_all, reusable across calls).
+typedef struct {
+    zstr_view *items;
+    size_t count;
+    size_t cap;
+} zstr_view_array;
+
+// Precompiled needle for repeated searches over many haystacks.
+// The needle bytes are borrowed and must outlive the searcher.
+typedef struct {
+    zstr_view needle;
+    size_t rare1;           // Offsets of the two rarest needle bytes (filter kernel).
+    size_t rare2;
+    size_t suffix;          // Two-Way critical factorization (long needles).
+    size_t period;
+    uint32_t shift[256];    // Horspool bad-character shifts (long needles).
+} zstr_searcher;
+
+// Iterator state for walking every (non-overlapping) match of a searcher.
+typedef struct {
+    const zstr_searcher *searcher;
+    zstr_view source;
+    size_t pos;
+    bool finished;
+} zstr_search_iter;
+
 // Iterator state for splitting strings.
 typedef struct {
     zstr_view source;
@@ -244,31 +483,268 @@ typedef struct {
     bool finished;
 } zstr_split_iter;
 
+// Multi-pattern (Aho-Corasick) automaton. Small pattern sets are compiled to a
+// dense DFA (one 256-entry row per state); large sets keep a compact NFA with
+// sorted transitions in flat arrays plus failure links.
+typedef struct {
+    uint32_t *delta;        // Dense DFA rows (NULL in compact mode).
+    uint32_t *root;         // Compact mode: dense row for the root state.
+    uint32_t *trans_off;    // Compact mode: per-state range into trans_byte/trans_next.
+    uint8_t  *trans_byte;
+    uint32_t *trans_next;
+    uint32_t *fail;
+    uint32_t *out;          // First pattern ending at each state (UINT32_MAX if none).
+    uint32_t *out_link;     // Nearest suffix state with an output (UINT32_MAX if none).
+    uint32_t *dup_next;     // Next pattern id ending at the same state (duplicates).
+    size_t   *pat_len;
+    size_t state_count;
+    size_t pattern_count;
+} zstr_matcher;
+
+// A single match reported by the matcher.
+typedef struct {
+    size_t id;      // Index of the pattern in the array passed to zstr_matcher_init.
+    size_t start;   // Byte offset of the match in the scanned view.
+    size_t len;
+} zstr_match;
+
+// Iterator state for a single pass over a view with a matcher.
+typedef struct {
+    const zstr_matcher *m;
+    zstr_view source;
+    size_t pos;
+    uint32_t state;
+    uint32_t pending_state;
+    uint32_t pending_pat;
+} zstr_matcher_iter;
+
+// One shard of an intern pool: open-addressing table of (hash tag << 32 | index + 1)
+// slots, an id -> view array and the arena holding the bytes.
+typedef struct {
+    uint64_t *slots;
+    zstr_view *entries;
+    size_t slot_cap;
+    size_t count;
+    size_t entries_cap;
+    size_t string_bytes;
+    zstr_arena arena;
+    long lock;
+} zstr_intern_shard;
+
+// String interning pool (see zstr_intern_init).
+typedef struct {
+    zstr_intern_shard *shards;
+    uint32_t shard_count;
+    uint8_t shard_bits;
+    bool locked;
+} zstr_intern;
+
+// Canonical handle of an interned string: compare ids (or view.data) for equality.
+typedef struct {
+    zstr_view view;
+    uint32_t id;
+} zstr_interned;
+
+// Memory counters of an intern pool.
+typedef struct {
+    size_t count;           // Distinct strings.
+    size_t string_bytes;    // Sum of their lengths.
+    size_t arena_bytes;     // Arena blocks holding the bytes.
+    size_t table_bytes;     // Hash slots and id -> view arrays.
+} zstr_intern_stats;
+
+// Reference-counted byte block of a rope; the bytes follow it in the same allocation.
+// Bytes below `used` are never modified, so several ropes can share a chunk.
+typedef struct {
+    size_t refs;    // Reference count (updated atomically).
+    size_t cap;
+    size_t used;
+    uint8_t alloc;  // Allocator the block came from.
+} zstr_rope_block;
+
+// One piece of a rope: a slice of a chunk, or of borrowed memory when chunk is NULL.
+typedef struct {
+    zstr_rope_block *chunk;
+    const char *data;
+    size_t len;
+    size_t end;     // Rope offset just past this piece (binary search key).
+} zstr_rope_piece;
+
+// Chunked string builder (see zstr_rope_init). Appends never move existing bytes.
+typedef struct {
+    zstr_rope_piece *pieces;
+    size_t count;
+    size_t cap;
+    size_t len;
+    size_t next_chunk;  // Capacity of the next chunk to allocate.
+} zstr_rope;
+
+// Iterator over the contiguous pieces of a rope.
+typedef struct {
+    const zstr_rope *rope;
+    size_t index;
+} zstr_rope_iter;
+
+// Resumable scatter-gather write (see zstr_writev_init_views). Exactly one of
+// views / strs / rope is set; the segments are borrowed until the write ends.
+typedef struct {
+    const zstr_view *views;
+    const zstr *strs;
+    const zstr_rope *rope;
+    size_t count;
+    size_t index;       // Next segment to write.
+    size_t offset;      // Bytes of that segment already written.
+    size_t written;     // Total bytes written so far.
+    size_t total;
+} zstr_writev_state;
+
+// Read-only memory-mapped file (see zstr_mmap_file). The bytes are not null-terminated.
+typedef struct {
+    const char *data;
+    size_t len;
+} zstr_mmap;
+
+// Buffered line reader over a file descriptor (see zstr_line_reader_init).
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t start;       // First byte of the line being assembled.
+    size_t end;         // Bytes of valid data in buf.
+    size_t scan;        // Next byte to classify.
+    size_t mask_base;   // Offset of bit 0 of mask.
+    uint32_t mask;      // Newlines at mask_base + bit that were not returned yet.
+    size_t block_size;
+    int fd;
+    int error;          // errno of the last failed read (0 if none).
+    bool eof;
+} zstr_line_reader;
+
+// Sparse rune -> byte offset index over a zstr (see zstr_rune_index_build).
+typedef struct {
+    size_t *offsets;    // offsets[k] = byte offset of rune k * ZSTR_RUNE_INDEX_STRIDE.
+    size_t count;
+    size_t cap;
+    size_t runes;       // Runes in the indexed prefix.
+    size_t bytes;       // Bytes indexed so far (the string length at the last update).
+} zstr_rune_index;
+
+// Outcome of a UTF-8 <-> UTF-16 / UTF-32 conversion.
+typedef struct {
+    int status;         // Z_OK, Z_EINVAL (bad input), Z_EOOB (output full) or Z_ENOMEM.
+    size_t read;        // Input units consumed; on Z_EINVAL, the offset of the bad sequence.
+    size_t written;     // Output units written (bytes when the output is a zstr).
+} zstr_transcode_result;
+
 
 /* Internal Helpers and Accessors */
 
 // Returns true if the string is heap-allocated.
 static inline bool zstr_is_long(const zstr *s)
 {
+#if defined(ZSTR_COMPACT)
+    return (((const unsigned char *)s)[ZSTR_SSO_CAP] & ZSTR__LONG_FLAG) != 0;
+#else
     return s->is_long;
+#endif
+}
+
+// Internal: drops the cached hash (ZSTR_CACHE_HASH). The field lies past the SSO
+// bytes, so clearing it unconditionally is safe for short strings too.
+static inline void zstr__hash_reset(zstr *s)
+{
+#if defined(ZSTR_CACHE_HASH)
+    s->l.hash = 0;
+#else
+    (void)s;
+#endif
+}
+
+// Internal: all ones for long strings, zero for short ones. The accessors below
+// load from both union members and select with this mask, so mixed short/long
+// workloads do not pay for mispredicted branches. The loads go through memcpy:
+// reading the object bytes is defined in C and C++ whichever member is active,
+// and compiles to the same plain loads.
+static inline uintptr_t zstr__long_mask(const zstr *s)
+{
+    return (uintptr_t)0 - (uintptr_t)zstr_is_long(s);
+}
+
+// Internal: the bytes of l.ptr as an integer (meaningful for long strings only).
+static inline uintptr_t zstr__raw_ptr(const zstr *s)
+{
+    uintptr_t p = 0;
+    memcpy(&p, &s->l.ptr, sizeof(s->l.ptr));
+    return p;
+}
+
+// Internal: the short and long length fields (each meaningful in its own layout).
+static inline size_t zstr__raw_len(const zstr *s, size_t m)
+{
+    size_t ll;
+    uint8_t sl;
+    memcpy(&ll, &s->l.len, sizeof(ll));
+    memcpy(&sl, &s->s.len, sizeof(sl));
+    return (ll & m) | ((size_t)sl & ~m);
 }
 
-// Returns a pointer to the mutable data buffer.
+// Returns a pointer to the mutable data buffer (and drops a cached hash).
 static inline char* zstr_data(zstr *s)
 {
-    return s->is_long ? s->l.ptr : s->s.buf;
+    uintptr_t m = zstr__long_mask(s);
+    zstr__hash_reset(s);
+    return (char *)((zstr__raw_ptr(s) & m) | ((uintptr_t)s->s.buf & ~m));
 }
 
 // Returns a pointer to the const data buffer (C-string compatible).
 static inline const char* zstr_cstr(const zstr *s)
 {
-    return s->is_long ? s->l.ptr : s->s.buf;  
+    uintptr_t m = zstr__long_mask(s);
+    return (const char *)((zstr__raw_ptr(s) & m) | ((uintptr_t)s->s.buf & ~m));
 }
 
 // Returns the current length of the string (excluding null terminator).
 static inline size_t zstr_len(const zstr *s)
 {
-    return s->is_long ? s->l.len : s->s.len;    
+    return zstr__raw_len(s, (size_t)zstr__long_mask(s));
+}
+
+// Internal: heap capacity of a long string (excluding the null terminator).
+static inline size_t zstr__cap(const zstr *s)
+{
+#if defined(ZSTR_COMPACT)
+    return (size_t)(((uint64_t)s->l.cap_tag >> ZSTR__CAP_SHIFT) & ZSTR__CAP_MASK);
+#else
+    return s->l.cap;
+#endif
+}
+
+// Internal: updates the capacity of a long string, keeping its tag.
+static inline void zstr__set_cap(zstr *s, size_t cap)
+{
+#if defined(ZSTR_COMPACT)
+    uint64_t tag = ((const unsigned char *)s)[ZSTR_SSO_CAP];
+    #if ZSTR__CAP_SHIFT
+    s->l.cap_tag = (size_t)(((uint64_t)cap << 8) | tag);
+    #else
+    s->l.cap_tag = (size_t)((uint64_t)cap | (tag << 56));
+    #endif
+#else
+    s->l.cap = cap;
+#endif
+}
+
+// Internal: sets the length of either layout (the caller writes the terminator).
+static inline void zstr__set_len(zstr *s, size_t len)
+{
+    if (zstr_is_long(s)) s->l.len = len;
+    else s->s.len = (uint8_t)len;
+    zstr__hash_reset(s);
+}
+
+// Returns the capacity: heap capacity for long strings, ZSTR_SSO_CAP otherwise.
+static inline size_t zstr_capacity(const zstr *s)
+{
+    return zstr_is_long(s) ? zstr__cap(s) : ZSTR_SSO_CAP;
 }
 
 // Returns true if the string length is 0.
@@ -278,1159 +754,6773 @@ static inline bool zstr_is_empty(const zstr *s)
 }
 
 
-/* Creation and Destruction */
+/* SIMD Kernels (Internal) */
 
-// Initializes an empty string {0}.
-static inline zstr zstr_init(void)
+// Index of the lowest set bit (x must be non-zero).
+static inline unsigned zstr__ctz32(uint32_t x)
 {
-    zstr s;
-    memset(&s, 0, sizeof(zstr));
-    return s;
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned)__builtin_ctz(x);
+#elif defined(_MSC_VER)
+    unsigned long idx;
+    _BitScanForward(&idx, x);
+    return (unsigned)idx;
+#else
+    unsigned n = 0;
+    while (!(x & 1u)) { x >>= 1; n++; }
+    return n;
+#endif
 }
 
-// Frees the string if it is on the heap, and resets it to empty.
-static inline void zstr_free(zstr *s)
+// Number of set bits.
+static inline unsigned zstr__popcount32(uint32_t x)
 {
-    if (s->is_long) Z_STR_FREE(s->l.ptr);
-    *s = zstr_init();
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned)__builtin_popcount(x);
+#else
+    x = x - ((x >> 1) & 0x55555555u);
+    x = (x & 0x33333333u) + ((x >> 2) & 0x33333333u);
+    return (unsigned)((((x + (x >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24);
+#endif
 }
 
-// Clears the content (sets length to 0) but keeps the allocated capacity.
-static inline void zstr_clear(zstr *s) 
+// True when the AVX2 kernels may run on this CPU.
+static inline bool zstr__cpu_has_avx2(void)
 {
-    if (s->is_long) 
-    {
-        s->l.len = 0;
-        s->l.ptr[0] = '\0';
-    } 
-    else 
-    {
-        s->s.len = 0;
-        s->s.buf[0] = '\0';
-    }
+#if defined(ZSTR_AVX2_DISPATCH)
+    return __builtin_cpu_supports("avx2") != 0;
+#elif defined(ZSTR_HAS_AVX2)
+    return true;
+#else
+    return false;
+#endif
 }
 
-
-/* Memory Management */
-
-// Ensures the string has at least `new_cap` capacity.
-// Handles the transition from SSO (Stack) to Long (Heap).
-static inline int zstr_reserve(zstr *s, size_t new_cap)
+// Scalar candidate filter: jumps between occurrences of needle[i1] with memchr,
+// then checks needle[i2] before paying for the full memcmp.
+static inline const char* zstr__find_filter_scalar(const char *h, size_t hlen, size_t from,
+                                                   const char *n, size_t nlen, size_t i1, size_t i2)
 {
-    if (new_cap < ZSTR_SSO_CAP) return Z_OK;
-    if (s->is_long && new_cap <= s->l.cap) return Z_OK;
+    const size_t last = hlen - nlen;
+    const char b1 = n[i1];
+    const char b2 = n[i2];
 
-    char *new_ptr;
-    if (s->is_long)
+    while (from <= last)
     {
-        new_ptr = Z_STR_REALLOC(s->l.ptr, new_cap + 1);
+        const char *p = (const char *)memchr(h + from + i1, b1, last - from + 1);
+        if (!p) return NULL;
+
+        size_t pos = (size_t)(p - h) - i1;
+        if (h[pos + i2] == b2 && memcmp(h + pos, n, nlen) == 0) return h + pos;
+        from = pos + 1;
     }
-    else 
+    return NULL;
+}
+
+#if defined(ZSTR_HAS_SSE2)
+// SSE2 filter: compares needle[i1] and needle[i2] against 16 candidate positions at once.
+static inline const char* zstr__find_filter_sse2(const char *h, size_t hlen, size_t from,
+                                                 const char *n, size_t nlen, size_t i1, size_t i2)
+{
+    const size_t last = hlen - nlen;
+    const __m128i v1 = _mm_set1_epi8(n[i1]);
+    const __m128i v2 = _mm_set1_epi8(n[i2]);
+
+    for (; from + 15 <= last; from += 16)
     {
-        new_ptr = Z_STR_MALLOC(new_cap + 1);
-        if (new_ptr)
+        __m128i a = _mm_loadu_si128((const __m128i *)(h + from + i1));
+        __m128i b = _mm_loadu_si128((const __m128i *)(h + from + i2));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, v1),
+                                                                  _mm_cmpeq_epi8(b, v2)));
+        while (mask)
         {
-            memcpy(new_ptr, s->s.buf, s->s.len);
-            new_ptr[s->s.len] = '\0';
+            size_t pos = from + zstr__ctz32(mask);
+            if (memcmp(h + pos, n, nlen) == 0) return h + pos;
+            mask &= mask - 1;
         }
     }
+    return zstr__find_filter_scalar(h, hlen, from, n, nlen, i1, i2);
+}
+#endif
 
-    if (!new_ptr) return Z_ERR;
+#if defined(ZSTR_HAS_AVX2)
+// AVX2 filter: same as the SSE2 one with 32 candidate positions per step.
+ZSTR_TARGET_AVX2
+static inline const char* zstr__find_filter_avx2(const char *h, size_t hlen, size_t from,
+                                                 const char *n, size_t nlen, size_t i1, size_t i2)
+{
+    const size_t last = hlen - nlen;
+    const __m256i v1 = _mm256_set1_epi8(n[i1]);
+    const __m256i v2 = _mm256_set1_epi8(n[i2]);
 
-    // Transition state if we were short before.
-    if (!s->is_long)
+    for (; from + 31 <= last; from += 32)
     {
-        s->l.len   = s->s.len;
-        s->is_long = 1;
+        __m256i a = _mm256_loadu_si256((const __m256i *)(h + from + i1));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(h + from + i2));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, v1),
+                                                                        _mm256_cmpeq_epi8(b, v2)));
+        while (mask)
+        {
+            size_t pos = from + zstr__ctz32(mask);
+            if (memcmp(h + pos, n, nlen) == 0) return h + pos;
+            mask &= mask - 1;
+        }
     }
-
-    s->l.ptr = new_ptr;
-    s->l.cap = new_cap;
-
-    return Z_OK;
+    return zstr__find_filter_scalar(h, hlen, from, n, nlen, i1, i2);
 }
+#endif
 
-// Creates a new empty string with pre-allocated capacity on the heap.
-static inline zstr zstr_with_capacity(size_t cap)
+// Finds needle in h[from..hlen) using two filter bytes at needle offsets i1 and i2.
+// Requires nlen >= 1, i1/i2 < nlen and from + nlen <= hlen.
+static inline const char* zstr__find_filter(const char *h, size_t hlen, size_t from,
+                                            const char *n, size_t nlen, size_t i1, size_t i2)
 {
-    zstr s = zstr_init();
-    if (cap > ZSTR_SSO_CAP)
+#if defined(ZSTR_HAS_AVX2)
+    if (hlen - from >= nlen + 31 && zstr__cpu_has_avx2())
     {
-        zstr_reserve(&s, cap);
+        return zstr__find_filter_avx2(h, hlen, from, n, nlen, i1, i2);
     }
-    return s;
+#endif
+#if defined(ZSTR_HAS_SSE2)
+    return zstr__find_filter_sse2(h, hlen, from, n, nlen, i1, i2);
+#else
+    return zstr__find_filter_scalar(h, hlen, from, n, nlen, i1, i2);
+#endif
 }
 
-// Reduces heap usage to fit the exact string length (or moves back to SSO if small enough).
-static inline void zstr_shrink_to_fit(zstr *s)
+// Internal: records the field [start, end) if there is room, and counts it either way.
+static inline void zstr__emit_field(zstr_view *out, size_t cap, size_t *count,
+                                    const char *p, size_t start, size_t end)
 {
-    if (!s->is_long) return;
-
-    // Downgrade to SSO if possible.
-    if (s->l.len <= ZSTR_SSO_CAP)
+    if (*count < cap)
     {
-        char temp[ZSTR_SSO_CAP];
-        memcpy(temp, s->l.ptr, s->l.len);
-        temp[s->l.len] = '\0';
-
-        uint8_t old_len = (uint8_t)s->l.len;
-        Z_STR_FREE(s->l.ptr);
+        out[*count].data = p + start;
+        out[*count].len = end - start;
+    }
+    (*count)++;
+}
 
-        s->is_long = 0;
-        memcpy(s->s.buf, temp, old_len + 1);
-        s->s.len = old_len;
-        return;
+// Scalar byte split over p[i..len). `start` is the beginning of the current field.
+static inline size_t zstr__split_byte_scalar(const char *p, size_t len, size_t i, size_t *start,
+                                             char c, zstr_view *out, size_t cap, size_t count)
+{
+    const char *hit;
+    while (i < len && (hit = (const char *)memchr(p + i, c, len - i)) != NULL)
+    {
+        size_t pos = (size_t)(hit - p);
+        zstr__emit_field(out, cap, &count, p, *start, pos);
+        *start = pos + 1;
+        i = pos + 1;
     }
+    return count;
+}
 
-    if (s->l.len < s->l.cap)
+#if defined(ZSTR_HAS_SSE2)
+// SSE2 byte split: one compare + movemask per 16 bytes, then walks the set bits.
+static inline size_t zstr__split_byte_sse2(const char *p, size_t len, size_t *i_io, size_t *start,
+                                           char c, zstr_view *out, size_t cap, size_t count)
+{
+    const __m128i splat = _mm_set1_epi8(c);
+    size_t i = *i_io;
+    for (; i + 16 <= len; i += 16)
     {
-        char *new_ptr = Z_STR_REALLOC(s->l.ptr, s->l.len + 1);
-        if (new_ptr)
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + i)), splat));
+        while (mask)
         {
-            s->l.ptr = new_ptr;
-            s->l.cap = s->l.len;
+            size_t pos = i + zstr__ctz32(mask);
+            zstr__emit_field(out, cap, &count, p, *start, pos);
+            *start = pos + 1;
+            mask &= mask - 1;
         }
     }
+    *i_io = i;
+    return count;
 }
+#endif
 
-
-/* Construction Helpers */
-
-// Helper: Creates zstr from ptr + explicit len.
-static inline zstr zstr_from_len(const char *ptr, size_t len)
+#if defined(ZSTR_HAS_AVX2)
+// AVX2 byte split: 32 bytes per step.
+ZSTR_TARGET_AVX2
+static inline size_t zstr__split_byte_avx2(const char *p, size_t len, size_t *i_io, size_t *start,
+                                           char c, zstr_view *out, size_t cap, size_t count)
 {
-    zstr s = zstr_init();
-    if (len >= ZSTR_SSO_CAP)
+    const __m256i splat = _mm256_set1_epi8(c);
+    size_t i = *i_io;
+    for (; i + 32 <= len; i += 32)
     {
-        if (zstr_reserve(&s, len) != Z_OK) return s;
-        memcpy(s.l.ptr, ptr, len);
-        s.l.ptr[len] = '\0';
-        s.l.len = len;
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + i)), splat));
+        while (mask)
+        {
+            size_t pos = i + zstr__ctz32(mask);
+            zstr__emit_field(out, cap, &count, p, *start, pos);
+            *start = pos + 1;
+            mask &= mask - 1;
+        }
     }
-    else 
+    *i_io = i;
+    return count;
+}
+
+ZSTR_TARGET_AVX2
+static inline size_t zstr__count_byte_avx2(const char *p, size_t len, size_t *i_io, char c)
+{
+    const __m256i splat = _mm256_set1_epi8(c);
+    size_t i = *i_io, n = 0;
+    for (; i + 32 <= len; i += 32)
     {
-        memcpy(s.s.buf, ptr, len);
-        s.s.buf[len] = '\0';
-        s.s.len = (uint8_t)len;
-        s.is_long = 0;
+        n += zstr__popcount32((uint32_t)_mm256_movemask_epi8(
+                 _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + i)), splat)));
     }
-    return s;
+    *i_io = i;
+    return n;
 }
+#endif
 
-// Creates a zstr from a standard C-string.
-static inline zstr zstr_from(const char *cstr)
+// Splits p[0..len) on byte c into out[0..cap). Returns the total number of fields.
+static inline size_t zstr__split_byte(const char *p, size_t len, char c, zstr_view *out, size_t cap)
 {
-    return zstr_from_len(cstr, strlen(cstr));
+    size_t i = 0, start = 0, count = 0;
+#if defined(ZSTR_HAS_AVX2)
+    if (len >= 32 && zstr__cpu_has_avx2()) count = zstr__split_byte_avx2(p, len, &i, &start, c, out, cap, count);
+#endif
+#if defined(ZSTR_HAS_SSE2)
+    count = zstr__split_byte_sse2(p, len, &i, &start, c, out, cap, count);
+#endif
+    count = zstr__split_byte_scalar(p, len, i, &start, c, out, cap, count);
+    zstr__emit_field(out, cap, &count, p, start, len);
+    return count;
 }
 
-// Macro for compile-time string literals (avoids runtime strlen).
-#define zstr_lit(s) zstr_from_len((s), sizeof(s) - 1)
-
-// Creates a deep copy of a zstr.
-static inline zstr zstr_dup(const zstr *s) 
+// Counts occurrences of byte c in p[0..len).
+static inline size_t zstr__count_byte(const char *p, size_t len, char c)
 {
-    return zstr_from_len(zstr_cstr(s), zstr_len(s));
+    size_t i = 0, n = 0;
+#if defined(ZSTR_HAS_AVX2)
+    if (len >= 32 && zstr__cpu_has_avx2()) n = zstr__count_byte_avx2(p, len, &i, c);
+#endif
+#if defined(ZSTR_HAS_SSE2)
+    const __m128i splat = _mm_set1_epi8(c);
+    for (; i + 16 <= len; i += 16)
+    {
+        n += zstr__popcount32((uint32_t)_mm_movemask_epi8(
+                 _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + i)), splat)));
+    }
+#endif
+    for (; i < len; i++) n += (p[i] == c);
+    return n;
 }
 
-// Takes ownership of a malloc'd pointer.
-static inline zstr zstr_own(char *ptr, size_t len, size_t cap)
+// Bitmask of the positions of byte c in p[0..32). Used by scanners that keep
+// the mask between calls and pop one hit at a time (see zstr_line_reader).
+static inline uint32_t zstr__byte_mask32(const char *p, char c)
 {
-    zstr s = zstr_init();
-    
-    if (cap <= ZSTR_SSO_CAP)
+#if defined(ZSTR_HAS_AVX2) && !defined(ZSTR_AVX2_DISPATCH)
+    return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)p), _mm256_set1_epi8(c)));
+#elif defined(ZSTR_HAS_SSE2)
+    const __m128i splat = _mm_set1_epi8(c);
+    uint32_t lo = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)p), splat));
+    uint32_t hi = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + 16)), splat));
+    return lo | (hi << 16);
+#else
+    uint32_t mask = 0;
+    for (unsigned i = 0; i < 32; i++) mask |= (uint32_t)(p[i] == c) << i;
+    return mask;
+#endif
+}
+
+// Two-Way critical factorization. Returns the start of the right half and
+// stores the period of the needle's maximal suffix in `period`.
+static inline size_t zstr__critical_factorization(const unsigned char *n, size_t nlen, size_t *period)
+{
+    size_t max_suffix = SIZE_MAX, max_suffix_rev = SIZE_MAX;
+    size_t j, k, p;
+
+    // Lexicographic maximal suffix.
+    j = 0; k = p = 1;
+    while (j + k < nlen)
     {
-        memcpy(s.s.buf, ptr, len);
-        s.s.buf[len] = '\0';
-        s.s.len = (uint8_t)len;
-        s.is_long = 0;
-        Z_STR_FREE(ptr);
+        unsigned char a = n[j + k];
+        unsigned char b = n[max_suffix + k];
+        if (a < b)       { j += k; k = 1; p = j - max_suffix; }
+        else if (a == b) { if (k != p) k++; else { j += p; k = 1; } }
+        else             { max_suffix = j++; k = p = 1; }
     }
-    else
+    *period = p;
+
+    // Reverse lexicographic maximal suffix.
+    j = 0; k = p = 1;
+    while (j + k < nlen)
     {
-        s.is_long = 1;
-        s.l.ptr = ptr;
-        s.l.len = len;
-        s.l.cap = cap;
+        unsigned char a = n[j + k];
+        unsigned char b = n[max_suffix_rev + k];
+        if (b < a)       { j += k; k = 1; p = j - max_suffix_rev; }
+        else if (a == b) { if (k != p) k++; else { j += p; k = 1; } }
+        else             { max_suffix_rev = j++; k = p = 1; }
     }
-    return s;
+
+    // Keep the longer suffix.
+    if (max_suffix_rev + 1 < max_suffix + 1) return max_suffix + 1;
+    *period = p;
+    return max_suffix_rev + 1;
 }
 
-// Releases ownership. Returns a malloc'd pointer the user MUST free.
-static inline char* zstr_take(zstr *s)
+// Crochemore-Perrin Two-Way search: linear time, constant space.
+// Used for long needles where the byte filter could degrade quadratically.
+static inline const char* zstr__find_twoway(const char *hay, size_t hlen, size_t from,
+                                            const char *ndl, size_t nlen)
 {
-    char *ptr;
-
-    if (s->is_long)
+    const unsigned char *h = (const unsigned char *)hay;
+    const unsigned char *n = (const unsigned char *)ndl;
+    size_t period;
+    size_t suffix = zstr__critical_factorization(n, nlen, &period);
+    size_t j = from;
+    size_t i;
+
+    if (memcmp(n, n + period, suffix) == 0)
     {
-        ptr = s->l.ptr;
+        // Periodic needle: remember how much of the prefix already matched.
+        size_t memory = 0;
+        while (j + nlen <= hlen)
+        {
+            i = suffix > memory ? suffix : memory;
+            while (i < nlen && n[i] == h[i + j]) i++;
+            if (i >= nlen)
+            {
+                i = suffix - 1;
+                while (memory < i + 1 && n[i] == h[i + j]) i--;
+                if (i + 1 < memory + 1) return hay + j;
+                j += period;
+                memory = nlen - period;
+            }
+            else
+            {
+                j += i - suffix + 1;
+                memory = 0;
+            }
+        }
     }
     else
     {
-        ptr = Z_STR_MALLOC(s->s.len + 1);
-        if (ptr)
+        // Halves are distinct: any mismatch allows a maximal shift.
+        period = (suffix > nlen - suffix ? suffix : nlen - suffix) + 1;
+        while (j + nlen <= hlen)
         {
-            memcpy(ptr, s->s.buf, s->s.len);
-            ptr[s->s.len] = '\0';
+            i = suffix;
+            while (i < nlen && n[i] == h[i + j]) i++;
+            if (i >= nlen)
+            {
+                i = suffix - 1;
+                while (i != SIZE_MAX && n[i] == h[i + j]) i--;
+                if (i == SIZE_MAX) return hay + j;
+                j += period;
+            }
+            else
+            {
+                j += i - suffix + 1;
+            }
         }
     }
-    
-    // Reset the source struct so it doesn't double-free.
-    *s = zstr_init();
-    return ptr;
+    return NULL;
 }
 
-
-// Reads an entire file into a zstr. Returns empty on failure.
-static inline zstr zstr_read_file(const char *path)
+// Two-Way with a Horspool shift table on the last needle byte (glibc's long
+// needle variant). `suffix`/`period` come from zstr__critical_factorization.
+static inline const char* zstr__find_twoway_shift(const char *hay, size_t hlen, size_t from,
+                                                  const char *ndl, size_t nlen, size_t suffix,
+                                                  size_t period, const uint32_t *shift_table)
 {
-    zstr s = zstr_init();
-    FILE *f = fopen(path, "rb"); 
-    if (!f) return s;
-
-    fseek(f, 0, SEEK_END);
-    long length = ftell(f);
-    fseek(f, 0, SEEK_SET);
+    const unsigned char *h = (const unsigned char *)hay;
+    const unsigned char *n = (const unsigned char *)ndl;
+    size_t j = from;
+    size_t i;
 
-    // Pedantic check.
-    if (length <= 0 || (sizeof(long) > sizeof(size_t) && (size_t)length > (size_t)-1))
+    if (memcmp(n, n + period, suffix) == 0)
     {
-        fclose(f);
-        return s;
+        size_t memory = 0;
+        while (j + nlen <= hlen)
+        {
+            size_t shift = shift_table[h[j + nlen - 1]];
+            if (shift > 0)
+            {
+                // The needle is periodic but the last period is broken: skip past it.
+                if (memory && shift < period) shift = nlen - period;
+                memory = 0;
+                j += shift;
+                continue;
+            }
+            i = suffix > memory ? suffix : memory;
+            while (i < nlen - 1 && n[i] == h[i + j]) i++;
+            if (i >= nlen - 1)
+            {
+                i = suffix - 1;
+                while (memory < i + 1 && n[i] == h[i + j]) i--;
+                if (i + 1 < memory + 1) return hay + j;
+                j += period;
+                memory = nlen - period;
+            }
+            else
+            {
+                j += i - suffix + 1;
+                memory = 0;
+            }
+        }
     }
-
-    if (zstr_reserve(&s, (size_t)length) != Z_OK) 
+    else
     {
-        fclose(f);
-        return s;
+        period = (suffix > nlen - suffix ? suffix : nlen - suffix) + 1;
+        while (j + nlen <= hlen)
+        {
+            size_t shift = shift_table[h[j + nlen - 1]];
+            if (shift > 0)
+            {
+                j += shift;
+                continue;
+            }
+            i = suffix;
+            while (i < nlen - 1 && n[i] == h[i + j]) i++;
+            if (i >= nlen - 1)
+            {
+                i = suffix - 1;
+                while (i != SIZE_MAX && n[i] == h[i + j]) i--;
+                if (i == SIZE_MAX) return hay + j;
+                j += period;
+            }
+            else
+            {
+                j += i - suffix + 1;
+            }
+        }
     }
+    return NULL;
+}
 
-    char *buf = zstr_data(&s);
-    size_t read_count = fread(buf, 1, (size_t)length, f);
-    buf[read_count] = '\0';
-
-    if (s.is_long) s.l.len = read_count;
-    else s.s.len = (uint8_t)read_count;
+// Approximate byte frequency rank in text/log/code data (higher = more common).
+// Used to pick the rarest needle bytes as SIMD filter anchors.
+static const uint8_t zstr__byte_rank[256] = {
+     60,  20,  20,  20,  20,  20,  20,  20,  20, 150, 200,  20,  20, 140,  20,  20,
+     20,  20,  20,  20,  20,  20,  20,  20,  20,  20,  20,  20,  20,  20,  20,  20,
+    255, 120, 170, 120, 120, 120, 120, 120, 170, 170, 120, 120, 190, 170, 190, 170,
+    200, 195, 190, 180, 180, 180, 180, 180, 180, 180, 170, 120, 120, 170, 120, 120,
+    120, 180, 125, 152, 155, 190, 140, 135, 165, 176,  80, 110, 160, 145, 175, 178,
+    138,  75, 170, 172, 185, 150, 115, 130,  90, 128,  70, 120, 120, 120, 120, 170,
+    120, 240, 185, 212, 215, 250, 200, 195, 225, 236, 140, 170, 220, 205, 235, 238,
+    198, 135, 230, 232, 245, 210, 175, 190, 150, 188, 130, 120, 120, 120, 120,  10,
+     90,  90,  90,  90,  90,  90,  90,  90,  90,  90,  90,  90,  90,  90,  90,  90,
+     90,  90,  90,  90,  90,  90,  90,  90,  90,  90,  90,  90,  90,  90,  90,  90,
+     90,  90,  90,  90,  90,  90,  90,  90,  90,  90,  90,  90,  90,  90,  90,  90,
+     90,  90,  90,  90,  90,  90,  90,  90,  90,  90,  90,  90,  90,  90,  90,  90,
+     80,  80,  80,  80,  80,  80,  80,  80,  80,  80,  80,  80,  80,  80,  80,  80,
+     80,  80,  80,  80,  80,  80,  80,  80,  80,  80,  80,  80,  80,  80,  80,  80,
+     70,  70,  70,  70,  70,  70,  70,  70,  70,  70,  70,  70,  70,  70,  70,  70,
+     30,  30,  30,  30,  30,  30,  30,  30,  30,  30,  30,  30,  30,  30,  30,  60,
+};
+
+// Length-aware substring search (embedded NULs allowed). Picks the kernel from
+// the needle length: memchr, SIMD first/last byte filter, or Two-Way.
+static inline const char* zstr__memmem(const char *h, size_t hlen, const char *n, size_t nlen)
+{
+    if (nlen == 0) return h;
+    if (nlen > hlen) return NULL;
+    if (nlen == 1) return (const char *)memchr(h, n[0], hlen);
+    if (nlen > ZSTR_TWOWAY_THRESHOLD) return zstr__find_twoway(h, hlen, 0, n, nlen);
+    return zstr__find_filter(h, hlen, 0, n, nlen, 0, nlen - 1);
+}
 
-    fclose(f);
-    return s;
+// Internal: true if the 8 bytes at p are all ASCII.
+static inline bool zstr__ascii8(const unsigned char *p)
+{
+    uint64_t w;
+    memcpy(&w, p, 8);
+    return (w & 0x8080808080808080ULL) == 0;
 }
 
-// Appends a single character to the string.
-static inline int zstr_push_char(zstr *s, char c)
+// Scalar strict UTF-8 check of p[i..len), starting on a character boundary.
+// Rejects overlongs, surrogates, values above U+10FFFF and truncated
+// sequences. Runs of ASCII are skipped 8 bytes at a time.
+static inline bool zstr__utf8_valid_scalar(const unsigned char *p, size_t len, size_t i)
 {
-    size_t len = zstr_len(s);
-    if (len + 1 >= (s->is_long ? s->l.cap : ZSTR_SSO_CAP))
+    while (i < len)
     {
-        size_t cap = s->is_long ? s->l.cap : ZSTR_SSO_CAP;
-        size_t new_cap = Z_GROWTH_FACTOR(cap);
-
-        if (zstr_reserve(s, new_cap) != Z_OK) return Z_ERR;
-    }
+        if (i + 8 <= len && zstr__ascii8(p + i))
+        {
+            i += 8;
+            continue;
+        }
 
-    char *p = zstr_data(s);
-    p[len] = c;
-    p[len + 1] = '\0';
+        unsigned char c = p[i];
+        if (c < 0x80)
+        {
+            i++;
+            continue;
+        }
+        if (c < 0xC2 || c > 0xF4) return false;
 
-    if (s->is_long) s->l.len++;
-    else s->s.len++;
+        size_t n = (c < 0xE0) ? 2 : (c < 0xF0) ? 3 : 4;
+        if (len - i < n) return false;
 
-    return Z_OK;    
-}
+        // The second byte carries the overlong, surrogate and range limits.
+        unsigned char lo = 0x80, hi = 0xBF, c1 = p[i + 1];
+        if (c == 0xE0) lo = 0xA0;
+        else if (c == 0xED) hi = 0x9F;
+        else if (c == 0xF0) lo = 0x90;
+        else if (c == 0xF4) hi = 0x8F;
+        if (c1 < lo || c1 > hi) return false;
 
-// Removes and returns the last character of the string.
-static inline char zstr_pop_char(zstr *s)
-{
-    size_t len = zstr_len(s);
-    if (len == 0) return '\0';
-    
-    char *p = zstr_data(s);
-    char c = p[len - 1];
-    p[len - 1] = '\0';
-    
-    if (s->is_long) s->l.len--;
-    else s->s.len--;
-    
-    return c;
+        for (size_t k = 2; k < n; k++)
+        {
+            if ((p[i + k] & 0xC0) != 0x80) return false;
+        }
+        i += n;
+    }
+    return true;
 }
 
-// Appends a raw char buffer of known length.
-static inline int zstr_cat_len(zstr *s, const char *src, size_t src_len)
+#if defined(ZSTR_HAS_SSE2)
+// SSE2 UTF-8 check: 16-byte ASCII blocks are accepted with one movemask. A
+// block with high bits goes through the scalar decoder, which stops on the
+// first character boundary past the block.
+static inline bool zstr__utf8_valid_sse2(const unsigned char *p, size_t len)
 {
-    size_t cur_len = zstr_len(s);
-    size_t req_cap = cur_len + src_len;
-
-    if (req_cap >= (s->is_long ? s->l.cap : ZSTR_SSO_CAP)) 
+    size_t i = 0;
+    while (i + 16 <= len)
     {
-        size_t new_cap = s->is_long ? s->l.cap : ZSTR_SSO_CAP;
-        // Logic fixed: starting cap is 23. If we grow, we just multiply.
-        // We do not fallback to 32 because 23 > 0.
-        if (new_cap == 0) new_cap = ZSTR_SSO_CAP;
-        
-        while (new_cap <= req_cap) new_cap = Z_GROWTH_FACTOR(new_cap);
-        
-        if (zstr_reserve(s, new_cap) != Z_OK) return Z_ERR;
-    }
-
-    char *dest = zstr_data(s);
-    memcpy(dest + cur_len, src, src_len);
-    dest[cur_len + src_len] = '\0';
-
-    if (s->is_long) s->l.len += src_len;
-    else s->s.len += (uint8_t)src_len;
+        if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(p + i))) == 0)
+        {
+            i += 16;
+            continue;
+        }
 
-    return Z_OK;
+        size_t stop = i + 16;
+        while (i < stop)
+        {
+            unsigned char c = p[i];
+            size_t n = (c < 0x80) ? 1 : (c < 0xE0) ? 2 : (c < 0xF0) ? 3 : 4;
+            if (n > len - i) n = len - i;
+            if (c >= 0x80 && !zstr__utf8_valid_scalar(p, i + n, i)) return false;
+            i += n;
+        }
+    }
+    return zstr__utf8_valid_scalar(p, len, i);
 }
+#endif
 
-// Appends a null-terminated C-string.
-static inline int zstr_cat(zstr *s, const char *cstr)
+#if defined(ZSTR_HAS_AVX2)
+// Keiser-Lemire error classes, one bit each. Three nibble lookups (high and low
+// nibble of the previous byte, high nibble of the current one) are ANDed; any
+// bit left standing is an error in that byte pair.
+#define ZSTR__U8_TOO_SHORT  (1 << 0)   // 11______ 0_______ / 11______ 11______
+#define ZSTR__U8_TOO_LONG   (1 << 1)   // 0_______ 10______
+#define ZSTR__U8_OVERLONG_3 (1 << 2)   // 11100000 100_____
+#define ZSTR__U8_TOO_LARGE  (1 << 3)   // 11110100 1001____ and above
+#define ZSTR__U8_SURROGATE  (1 << 4)   // 11101101 101_____
+#define ZSTR__U8_OVERLONG_2 (1 << 5)   // 1100000_ 10______
+#define ZSTR__U8_TOO_LARGE_1000 (1 << 6) // 11110101 1000____ and above
+#define ZSTR__U8_OVERLONG_4 (1 << 6)   // 11110000 1000____
+#define ZSTR__U8_TWO_CONTS  (1 << 7)   // 10______ 10______ (must be the 3rd/4th byte)
+#define ZSTR__U8_CARRY (ZSTR__U8_TOO_SHORT | ZSTR__U8_TOO_LONG | ZSTR__U8_TWO_CONTS)
+
+// Internal: the 32 bytes ending N bytes before `cur` (spanning into `prev`).
+#define ZSTR__U8_PREV(cur, prev, n) \
+    _mm256_alignr_epi8((cur), _mm256_permute2x128_si256((prev), (cur), 0x21), 16 - (n))
+
+// Internal: nibble lookup tables (high nibble of the previous byte, its low
+// nibble, high nibble of the current byte).
+static const uint8_t zstr__u8_byte1_high[16] = {
+    ZSTR__U8_TOO_LONG, ZSTR__U8_TOO_LONG, ZSTR__U8_TOO_LONG, ZSTR__U8_TOO_LONG,
+    ZSTR__U8_TOO_LONG, ZSTR__U8_TOO_LONG, ZSTR__U8_TOO_LONG, ZSTR__U8_TOO_LONG,
+    ZSTR__U8_TWO_CONTS, ZSTR__U8_TWO_CONTS, ZSTR__U8_TWO_CONTS, ZSTR__U8_TWO_CONTS,
+    ZSTR__U8_TOO_SHORT | ZSTR__U8_OVERLONG_2,
+    ZSTR__U8_TOO_SHORT,
+    ZSTR__U8_TOO_SHORT | ZSTR__U8_OVERLONG_3 | ZSTR__U8_SURROGATE,
+    ZSTR__U8_TOO_SHORT | ZSTR__U8_TOO_LARGE | ZSTR__U8_TOO_LARGE_1000 | ZSTR__U8_OVERLONG_4,
+};
+
+static const uint8_t zstr__u8_byte1_low[16] = {
+    ZSTR__U8_CARRY | ZSTR__U8_OVERLONG_3 | ZSTR__U8_OVERLONG_2 | ZSTR__U8_OVERLONG_4,
+    ZSTR__U8_CARRY | ZSTR__U8_OVERLONG_2,
+    ZSTR__U8_CARRY,
+    ZSTR__U8_CARRY,
+    ZSTR__U8_CARRY | ZSTR__U8_TOO_LARGE,
+    ZSTR__U8_CARRY | ZSTR__U8_TOO_LARGE | ZSTR__U8_TOO_LARGE_1000,
+    ZSTR__U8_CARRY | ZSTR__U8_TOO_LARGE | ZSTR__U8_TOO_LARGE_1000,
+    ZSTR__U8_CARRY | ZSTR__U8_TOO_LARGE | ZSTR__U8_TOO_LARGE_1000,
+    ZSTR__U8_CARRY | ZSTR__U8_TOO_LARGE | ZSTR__U8_TOO_LARGE_1000,
+    ZSTR__U8_CARRY | ZSTR__U8_TOO_LARGE | ZSTR__U8_TOO_LARGE_1000,
+    ZSTR__U8_CARRY | ZSTR__U8_TOO_LARGE | ZSTR__U8_TOO_LARGE_1000,
+    ZSTR__U8_CARRY | ZSTR__U8_TOO_LARGE | ZSTR__U8_TOO_LARGE_1000,
+    ZSTR__U8_CARRY | ZSTR__U8_TOO_LARGE | ZSTR__U8_TOO_LARGE_1000,
+    ZSTR__U8_CARRY | ZSTR__U8_TOO_LARGE | ZSTR__U8_TOO_LARGE_1000 | ZSTR__U8_SURROGATE,
+    ZSTR__U8_CARRY | ZSTR__U8_TOO_LARGE | ZSTR__U8_TOO_LARGE_1000,
+    ZSTR__U8_CARRY | ZSTR__U8_TOO_LARGE | ZSTR__U8_TOO_LARGE_1000,
+};
+
+static const uint8_t zstr__u8_byte2_high[16] = {
+    ZSTR__U8_TOO_SHORT, ZSTR__U8_TOO_SHORT, ZSTR__U8_TOO_SHORT, ZSTR__U8_TOO_SHORT,
+    ZSTR__U8_TOO_SHORT, ZSTR__U8_TOO_SHORT, ZSTR__U8_TOO_SHORT, ZSTR__U8_TOO_SHORT,
+    ZSTR__U8_TOO_LONG | ZSTR__U8_OVERLONG_2 | ZSTR__U8_TWO_CONTS | ZSTR__U8_OVERLONG_3 |
+        ZSTR__U8_TOO_LARGE_1000 | ZSTR__U8_OVERLONG_4,
+    ZSTR__U8_TOO_LONG | ZSTR__U8_OVERLONG_2 | ZSTR__U8_TWO_CONTS | ZSTR__U8_OVERLONG_3 | ZSTR__U8_TOO_LARGE,
+    ZSTR__U8_TOO_LONG | ZSTR__U8_OVERLONG_2 | ZSTR__U8_TWO_CONTS | ZSTR__U8_SURROGATE | ZSTR__U8_TOO_LARGE,
+    ZSTR__U8_TOO_LONG | ZSTR__U8_OVERLONG_2 | ZSTR__U8_TWO_CONTS | ZSTR__U8_SURROGATE | ZSTR__U8_TOO_LARGE,
+    ZSTR__U8_TOO_SHORT, ZSTR__U8_TOO_SHORT, ZSTR__U8_TOO_SHORT, ZSTR__U8_TOO_SHORT,
+};
+
+// Internal: a 16-entry table in both lanes, for _mm256_shuffle_epi8 lookups.
+ZSTR_TARGET_AVX2
+static inline __m256i zstr__u8_table(const uint8_t *t)
 {
-    return zstr_cat_len(s, cstr, strlen(cstr));
+    return _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)t));
 }
 
-// Joins an array of strings with a delimiter.
-static inline zstr zstr_join(const char **strings, size_t count, const char *delim)
+// Internal: errors of one 32-byte block given the previous block.
+ZSTR_TARGET_AVX2
+static inline __m256i zstr__utf8_block_avx2(__m256i in, __m256i prev, __m256i t1, __m256i t2, __m256i t3)
 {
-    zstr s = zstr_init();
-    if (count == 0) return s;
+    const __m256i nib = _mm256_set1_epi8(0x0F);
+    __m256i prev1 = ZSTR__U8_PREV(in, prev, 1);
+    __m256i b1_hi = _mm256_shuffle_epi8(t1, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nib));
+    __m256i b1_lo = _mm256_shuffle_epi8(t2, _mm256_and_si256(prev1, nib));
+    __m256i b2_hi = _mm256_shuffle_epi8(t3, _mm256_and_si256(_mm256_srli_epi16(in, 4), nib));
+    __m256i special = _mm256_and_si256(_mm256_and_si256(b1_hi, b1_lo), b2_hi);
+
+    // Third and fourth bytes of a sequence must be continuations (TWO_CONTS there is expected).
+    __m256i third = _mm256_subs_epu8(ZSTR__U8_PREV(in, prev, 2), _mm256_set1_epi8((char)(0xE0 - 0x80)));
+    __m256i fourth = _mm256_subs_epu8(ZSTR__U8_PREV(in, prev, 3), _mm256_set1_epi8((char)(0xF0 - 0x80)));
+    __m256i must23 = _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8((char)0x80));
+    return _mm256_xor_si256(must23, special);
+}
 
-    size_t delim_len = strlen(delim);
-    size_t total_len = 0;
+// AVX2 UTF-8 check (Keiser-Lemire lookup). All-ASCII 32-byte blocks only check
+// that the previous block did not end inside a sequence. The tail is copied
+// into a zero-padded block, so a truncated last character shows as TOO_SHORT.
+ZSTR_TARGET_AVX2
+static inline bool zstr__utf8_valid_avx2(const unsigned char *p, size_t len)
+{
+    // Non-zero where a lead byte in the last three positions still needs continuations.
+    const __m256i max_tail = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1));
+    const __m256i t1 = zstr__u8_table(zstr__u8_byte1_high);
+    const __m256i t2 = zstr__u8_table(zstr__u8_byte1_low);
+    const __m256i t3 = zstr__u8_table(zstr__u8_byte2_high);
+    __m256i prev = _mm256_setzero_si256();
+    __m256i incomplete = _mm256_setzero_si256();
+    __m256i err = _mm256_setzero_si256();
+    size_t i = 0;
 
-    for (size_t i = 0; i < count; i++)
+    for (; i + 32 <= len; i += 32)
     {
-        total_len += strlen(strings[i]);
-        if (i < count - 1) total_len += delim_len;
+        __m256i in = _mm256_loadu_si256((const __m256i *)(p + i));
+        if (_mm256_movemask_epi8(in) == 0)
+        {
+            err = _mm256_or_si256(err, incomplete);
+        }
+        else
+        {
+            err = _mm256_or_si256(err, zstr__utf8_block_avx2(in, prev, t1, t2, t3));
+            incomplete = _mm256_subs_epu8(in, max_tail);
+        }
+        prev = in;
+
+        // Checking every 32 blocks keeps the early exit without a test per block.
+        if ((i & 1023) == 992 && !_mm256_testz_si256(err, err)) return false;
     }
 
-    if (zstr_reserve(&s, total_len) != Z_OK) return s;
-    
-    for (size_t i = 0; i < count; i++)
+    if (i < len)
     {
-        zstr_cat(&s, strings[i]);
-        if (i < count - 1) zstr_cat(&s, delim);
+        unsigned char tail[32];
+        memset(tail, 0, sizeof(tail));
+        memcpy(tail, p + i, len - i);
+        __m256i in = _mm256_loadu_si256((const __m256i *)tail);
+        err = _mm256_or_si256(err, zstr__utf8_block_avx2(in, prev, t1, t2, t3));
     }
-    return s;
-}
-
-// Formats a string (printf style) and appends it.
-ZSTR_PRINTF_ATTR(2, 3)
-static inline int zstr_fmt(zstr *s, const char *fmt, ...) 
-{
-    va_list args;
-    va_start(args, fmt);
-    int len = vsnprintf(NULL, 0, fmt, args);
-    va_end(args);
-
-    if (len < 0) return Z_ERR;
-
-    size_t cur_len = zstr_len(s);
-    size_t req_cap = cur_len + len;
-    
-    if (req_cap >= (s->is_long ? s->l.cap : ZSTR_SSO_CAP)) 
+    else
     {
-        if (zstr_reserve(s, req_cap) != Z_OK) return Z_ERR;
+        err = _mm256_or_si256(err, incomplete);
     }
-
-    va_start(args, fmt);
-    char *buf = zstr_data(s);
-    vsnprintf(buf + cur_len, len + 1, fmt, args);
-    va_end(args);
-
-    if (s->is_long) s->l.len += len;
-    else s->s.len += (uint8_t)len;
-
-    return Z_OK;
+    return _mm256_testz_si256(err, err) != 0;
 }
+#endif
 
+// Internal: number of bytes in the 8 at p that are not UTF-8 continuations
+// (10xxxxxx). A byte starts a rune if bit 7 is clear or bit 6 is set.
+static inline size_t zstr__rune_starts8(const unsigned char *p)
+{
+    uint64_t w;
+    memcpy(&w, p, 8);
+    uint64_t starts = ((~w >> 7) | (w >> 6)) & 0x0101010101010101ULL;
+    return (size_t)((starts * 0x0101010101010101ULL) >> 56);
+}
 
-/* In-Place Transformations */
-
-// Converts the string to lowercase in-place (ASCII only).
-static inline void zstr_to_lower(zstr *s)
+#if defined(ZSTR_HAS_SSE2)
+// SSE2 continuation count: compare results are summed per byte lane and
+// flushed with psadbw before the 8-bit lanes can overflow.
+static inline size_t zstr__count_conts_sse2(const unsigned char *p, size_t len, size_t *i_io)
 {
-    char *p = zstr_data(s);
-    size_t len = zstr_len(s);
-    for (size_t i = 0; i < len; i++)
+    const __m128i limit = _mm_set1_epi8(-64);   // Continuations are -128..-65 as int8.
+    size_t i = *i_io, n = 0;
+    while (i + 16 <= len)
     {
-        p[i] = (char)tolower((unsigned char)p[i]);
+        __m128i acc = _mm_setzero_si128();
+        size_t blocks = (len - i) / 16;
+        if (blocks > 255) blocks = 255;
+        for (size_t b = 0; b < blocks; b++, i += 16)
+        {
+            __m128i in = _mm_loadu_si128((const __m128i *)(p + i));
+            acc = _mm_sub_epi8(acc, _mm_cmplt_epi8(in, limit));
+        }
+        __m128i sum = _mm_sad_epu8(acc, _mm_setzero_si128());
+        n += (size_t)_mm_cvtsi128_si32(sum) + (size_t)_mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
     }
+    *i_io = i;
+    return n;
 }
+#endif
 
-// Converts the string to uppercase in-place (ASCII only).
-static inline void zstr_to_upper(zstr *s)
+#if defined(ZSTR_HAS_AVX2)
+// AVX2 continuation count: 32 bytes per step, same lane accumulation.
+ZSTR_TARGET_AVX2
+static inline size_t zstr__count_conts_avx2(const unsigned char *p, size_t len, size_t *i_io)
 {
-    char *p = zstr_data(s);
-    size_t len = zstr_len(s);
-    for (size_t i = 0; i < len; i++)
+    const __m256i limit = _mm256_set1_epi8(-64);
+    size_t i = *i_io, n = 0;
+    while (i + 32 <= len)
     {
-        p[i] = (char)toupper((unsigned char)p[i]);
+        __m256i acc = _mm256_setzero_si256();
+        size_t blocks = (len - i) / 32;
+        if (blocks > 255) blocks = 255;
+        for (size_t b = 0; b < blocks; b++, i += 32)
+        {
+            __m256i in = _mm256_loadu_si256((const __m256i *)(p + i));
+            acc = _mm256_sub_epi8(acc, _mm256_cmpgt_epi8(limit, in));
+        }
+        __m256i sad = _mm256_sad_epu8(acc, _mm256_setzero_si256());
+        __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(sad), _mm256_extracti128_si256(sad, 1));
+        n += (size_t)_mm_cvtsi128_si32(sum) + (size_t)_mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
     }
+    *i_io = i;
+    return n;
 }
+#endif
 
-// Removes leading and trailing whitespace in-place.
-static inline void zstr_trim(zstr *s)
+// Counts the runes in p[0..len) as the bytes that are not continuations. This
+// is exact for valid UTF-8; in invalid input every lead or ASCII byte counts
+// once and stray continuations count zero.
+static inline size_t zstr__count_runes(const char *p, size_t len)
 {
-    if (zstr_len(s) == 0) return;
-
-    char *start = zstr_data(s);
-    char *end = start + zstr_len(s) - 1;
-
-    while (end >= start && isspace((unsigned char)*end))
+    const unsigned char *u = (const unsigned char *)p;
+    size_t i = 0, n = 0;
+#if defined(ZSTR_HAS_AVX2)
+    if (len >= 32 && zstr__cpu_has_avx2())
     {
-        *end = '\0';
-        end--;
+        size_t conts = zstr__count_conts_avx2(u, len, &i);
+        n = i - conts;
     }
-
-    size_t final_len = (end >= start) ? (size_t)(end - start + 1) : 0;
-    
-    char *new_start = start;
-    while (new_start <= end && isspace((unsigned char)*new_start))
+#endif
+#if defined(ZSTR_HAS_SSE2)
     {
-        new_start++;
+        size_t from = i;
+        size_t conts = zstr__count_conts_sse2(u, len, &i);
+        n += (i - from) - conts;
     }
-    
-    // Adjust final length based on left trim.
-    final_len = (new_start <= end) ? (size_t)(end - new_start + 1) : 0;
+#endif
+    for (; i + 8 <= len; i += 8) n += zstr__rune_starts8(u + i);
+    for (; i < len; i++) n += (u[i] & 0xC0) != 0x80;
+    return n;
+}
 
-    if (new_start > start)
+// Bitmask of the rune starts (non-continuation bytes) in p[0..n), n <= 64.
+static inline uint64_t zstr__rune_starts64(const unsigned char *p, size_t n)
+{
+    uint64_t conts = 0;
+    size_t i = 0;
+#if defined(ZSTR_HAS_AVX2) && !defined(ZSTR_AVX2_DISPATCH)
+    const __m256i limit = _mm256_set1_epi8(-64);
+    for (; i + 32 <= n; i += 32)
     {
-        memmove(start, new_start, final_len);
-        start[final_len] = '\0';
+        __m256i in = _mm256_loadu_si256((const __m256i *)(p + i));
+        conts |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi8(limit, in)) << i;
     }
+#endif
+#if defined(ZSTR_HAS_SSE2)
+    const __m128i limit16 = _mm_set1_epi8(-64);
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i in = _mm_loadu_si128((const __m128i *)(p + i));
+        conts |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmplt_epi8(in, limit16)) << i;
+    }
+#endif
+    for (; i < n; i++) conts |= (uint64_t)((p[i] & 0xC0) == 0x80) << i;
 
-    if (s->is_long) s->l.len = final_len;
-    else s->s.len = (uint8_t)final_len;
+    uint64_t valid = (n >= 64) ? ~0ULL : ((1ULL << n) - 1);
+    return ~conts & valid;
 }
 
-// Replaces all occurrences of "target" with "replacement". 
-// This may reallocate the string if the size grows.
-static inline int zstr_replace(zstr *s, const char *target, const char *replacement)
+// Number of set bits in a 64-bit mask.
+static inline unsigned zstr__popcount64(uint64_t x)
 {
-    if (!target || !*target) return Z_ERR;
-    
-    char *src = zstr_data(s);
-    char *p = strstr(src, target);
-    
-    if (!p) return Z_OK;
-
-    size_t target_len = strlen(target);
-    size_t repl_len = strlen(replacement);
-    size_t count = 0;
+    return zstr__popcount32((uint32_t)x) + zstr__popcount32((uint32_t)(x >> 32));
+}
 
-    char *scan = src;
-    while ((scan = strstr(scan, target)) != NULL) 
+// Position of the k-th (0-based) set bit of m (m must have more than k bits set).
+static inline unsigned zstr__select64(uint64_t m, unsigned k)
+{
+    unsigned lo = zstr__popcount32((uint32_t)m);
+    unsigned base = 0;
+    if (k >= lo)
     {
-        count++;
-        scan += target_len;
+        k -= lo;
+        m >>= 32;
+        base = 32;
     }
+    uint32_t w = (uint32_t)m;
+    while (k--) w &= w - 1;
+    return base + zstr__ctz32(w);
+}
 
-    size_t old_len = zstr_len(s);
-    size_t new_len = old_len + (count * (repl_len - target_len));
+// Strict UTF-8 validation of p[0..len) (NUL bytes are valid U+0000).
+static inline bool zstr__utf8_valid(const char *p, size_t len)
+{
+    const unsigned char *u = (const unsigned char *)p;
+#if defined(ZSTR_HAS_AVX2)
+    if (len >= 32 && zstr__cpu_has_avx2()) return zstr__utf8_valid_avx2(u, len);
+#endif
+#if defined(ZSTR_HAS_SSE2)
+    return zstr__utf8_valid_sse2(u, len);
+#else
+    return zstr__utf8_valid_scalar(u, len, 0);
+#endif
+}
 
-    zstr res = zstr_init();
-    if (zstr_reserve(&res, new_len) != Z_OK) return Z_ERR; 
 
-    char *dest = zstr_data(&res);
-    char *curr_src = src;
-    char *curr_dest = dest;
-    
-    while ((p = strstr(curr_src, target)) != NULL)
-    {
-        size_t segment_len = p - curr_src;
-        memcpy(curr_dest, curr_src, segment_len);
-        curr_dest += segment_len;
-        
-        memcpy(curr_dest, replacement, repl_len);
-        curr_dest += repl_len;
-        
-        curr_src = p + target_len;
-    }
+// Hash key material: a wyhash-style secret for short inputs and the stripe keys
+// of the long-input accumulator (xxh3-style, 8 x 64-bit lanes per 64-byte stripe).
+static const uint64_t zstr__hash_secret[4] = {
+    0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL, 0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
 
-    strcpy(curr_dest, curr_src);
-    
-    if (res.is_long) res.l.len = new_len;
-    else res.s.len = (uint8_t)new_len;
+static const uint64_t zstr__hash_key[16] = {
+    0x16a46f1e1e38bdb5ULL, 0xb3bb82d6075618edULL, 0x50dc01e2635b2518ULL, 0xa16e121ab81269b1ULL,
+    0xe07f82ef7ece6abbULL, 0x62c5bdb8ab90b16bULL, 0xea093fe498ccccf9ULL, 0xa7e0faf59efecb38ULL,
+    0x117d4a3557933472ULL, 0x40faf0f186d06de8ULL, 0x96ea130aad13875fULL, 0x194dfb9f3463b12aULL,
+    0x8ee8e6533cac78d5ULL, 0x0998ee2ea6b1ce01ULL, 0x4328953537b318b5ULL, 0xdbfa2804b4293c9aULL,
+};
 
-    zstr_free(s);
-    *s = res;
+#define ZSTR__HASH_PRIME32 0x9E3779B1U
+#define ZSTR__HASH_STRIPE  64
+#define ZSTR__HASH_BLOCK   8    // Stripes per block (between two scrambles).
 
-    return Z_OK;
+// Internal: unaligned native-endian loads.
+static inline uint64_t zstr__read64(const char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
 }
 
+static inline uint64_t zstr__read32(const char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
 
-/* Comparison */
+// Internal: 64x64 -> 128 multiply, returns low ^ high.
+static inline uint64_t zstr__mix64(uint64_t a, uint64_t b)
+{
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = (__uint128_t)a * b;
+    return (uint64_t)r ^ (uint64_t)(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    uint64_t hi, lo = _umul128(a, b, &hi);
+    return lo ^ hi;
+#else
+    uint64_t ha = a >> 32, hb = b >> 32, la = (uint32_t)a, lb = (uint32_t)b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+    return lo ^ hi;
+#endif
+}
 
-// Checks equality between two zstr objects (faster than strcmp).
-static inline bool zstr_eq(const zstr *a, const zstr *b)
+// Internal: final avalanche of the long-input hash.
+static inline uint64_t zstr__hash_avalanche(uint64_t h)
 {
-    size_t la = zstr_len(a);
-    size_t lb = zstr_len(b);
-    if (la != lb) return false;
-    return memcmp(zstr_cstr(a), zstr_cstr(b), la) == 0;
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    h ^= h >> 32;
+    return h;
 }
 
-// Checks equality ignoring case (ASCII only).
-static inline bool zstr_eq_ignore_case(const zstr *a, const zstr *b)
+// Internal: accumulates `stripes` 64-byte stripes; stripe j uses key words key[j..j+7].
+static inline void zstr__hash_accumulate_scalar(uint64_t *acc, const char *p, size_t stripes, const uint64_t *key)
 {
-    size_t len = zstr_len(a);
-    if (len != zstr_len(b)) return false;
-    
-    const char *p1 = zstr_cstr(a);
-    const char *p2 = zstr_cstr(b);
-    
-    for (size_t i = 0; i < len; i++) {
-        if (tolower((unsigned char)p1[i]) != tolower((unsigned char)p2[i])) {
-            return false;
+    for (size_t s = 0; s < stripes; s++)
+    {
+        for (size_t l = 0; l < 8; l++)
+        {
+            uint64_t d = zstr__read64(p + s * ZSTR__HASH_STRIPE + l * 8);
+            uint64_t dk = d ^ key[s + l];
+            acc[l ^ 1] += d;
+            acc[l] += (dk & 0xFFFFFFFFULL) * (dk >> 32);
         }
     }
-    return true;
 }
 
-// Standard strcmp behavior for zstr objects.
-static inline int zstr_cmp(const zstr *a, const zstr *b)
+// Internal: mixes the accumulator lanes at the end of each block.
+static inline void zstr__hash_scramble_scalar(uint64_t *acc, const uint64_t *key)
 {
-    return strcmp(zstr_cstr(a), zstr_cstr(b));
+    for (size_t l = 0; l < 8; l++)
+    {
+        uint64_t a = acc[l];
+        a ^= a >> 47;
+        a ^= key[l];
+        acc[l] = a * ZSTR__HASH_PRIME32;
+    }
 }
 
+#if defined(ZSTR_HAS_SSE2)
+static inline void zstr__hash_accumulate_sse2(uint64_t *acc, const char *p, size_t stripes, const uint64_t *key)
+{
+    __m128i a[4];
+    for (int i = 0; i < 4; i++) a[i] = _mm_loadu_si128((const __m128i *)(acc + 2 * i));
 
-/* Search */
+    for (size_t s = 0; s < stripes; s++)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            __m128i d  = _mm_loadu_si128((const __m128i *)(p + s * ZSTR__HASH_STRIPE + 16 * i));
+            __m128i k  = _mm_loadu_si128((const __m128i *)(key + s + 2 * i));
+            __m128i dk = _mm_xor_si128(d, k);
+            __m128i pr = _mm_mul_epu32(dk, _mm_srli_epi64(dk, 32));
+            __m128i sw = _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2));
+            a[i] = _mm_add_epi64(a[i], _mm_add_epi64(pr, sw));
+        }
+    }
 
-// Returns the index of the first occurrence of needle, or -1 if not found.
-static inline ptrdiff_t zstr_find(const zstr *s, const char *needle)
-{
-    const char *data = zstr_cstr(s);
-    const char *found = strstr(data, needle);
-    if (!found) return -1;
-    return (ptrdiff_t)(found - data);
+    for (int i = 0; i < 4; i++) _mm_storeu_si128((__m128i *)(acc + 2 * i), a[i]);
 }
+#endif
 
-// Returns true if the string contains the substring.
-static inline bool zstr_contains(const zstr *s, const char *needle)
+#if defined(ZSTR_HAS_AVX2)
+ZSTR_TARGET_AVX2
+static inline void zstr__hash_accumulate_avx2(uint64_t *acc, const char *p, size_t stripes, const uint64_t *key)
 {
-    return zstr_find(s, needle) != -1;
-}
+    __m256i a0 = _mm256_loadu_si256((const __m256i *)acc);
+    __m256i a1 = _mm256_loadu_si256((const __m256i *)(acc + 4));
 
+    for (size_t s = 0; s < stripes; s++)
+    {
+        const char *q = p + s * ZSTR__HASH_STRIPE;
+        __m256i d0 = _mm256_loadu_si256((const __m256i *)q);
+        __m256i d1 = _mm256_loadu_si256((const __m256i *)(q + 32));
+        __m256i k0 = _mm256_loadu_si256((const __m256i *)(key + s));
+        __m256i k1 = _mm256_loadu_si256((const __m256i *)(key + s + 4));
+        __m256i x0 = _mm256_xor_si256(d0, k0);
+        __m256i x1 = _mm256_xor_si256(d1, k1);
+        a0 = _mm256_add_epi64(a0, _mm256_add_epi64(_mm256_mul_epu32(x0, _mm256_srli_epi64(x0, 32)),
+                                                   _mm256_shuffle_epi32(d0, _MM_SHUFFLE(1, 0, 3, 2))));
+        a1 = _mm256_add_epi64(a1, _mm256_add_epi64(_mm256_mul_epu32(x1, _mm256_srli_epi64(x1, 32)),
+                                                   _mm256_shuffle_epi32(d1, _MM_SHUFFLE(1, 0, 3, 2))));
+    }
 
-/* UTF-8 Support */
+    _mm256_storeu_si256((__m256i *)acc, a0);
+    _mm256_storeu_si256((__m256i *)(acc + 4), a1);
+}
+#endif
 
-// Decodes the next rune from the pointer and advances the pointer.
-// Returns ZSTR_UTF8_INVALID (0xFFFD) on error.
-static inline uint32_t zstr_next_rune(const char **p)
+// Internal: picks the widest accumulate kernel available.
+static inline void zstr__hash_accumulate(uint64_t *acc, const char *p, size_t stripes, const uint64_t *key, bool avx2)
 {
-    const unsigned char *str = (const unsigned char *)*p;
-    unsigned char c = *str;
-
-    if (c == '\0') return 0;
-
-    if (c < 0x80) 
+#if defined(ZSTR_HAS_AVX2)
+    if (avx2)
     {
-        *p += 1;
-        return c;
+        zstr__hash_accumulate_avx2(acc, p, stripes, key);
+        return;
     }
+#endif
+    (void)avx2;
+#if defined(ZSTR_HAS_SSE2)
+    zstr__hash_accumulate_sse2(acc, p, stripes, key);
+#else
+    zstr__hash_accumulate_scalar(acc, p, stripes, key);
+#endif
+}
 
-    uint32_t rune = 0;
-    int len = 0;
+// Internal: long-input hash (len > 128). All kernels produce identical results.
+static inline uint64_t zstr__hash_long(const char *p, size_t len, uint64_t seed)
+{
+    // Seeded keys: every seed gets its own stripe keys, not just a different start.
+    uint64_t key[16];
+    for (size_t i = 0; i < 16; i++) key[i] = (i & 1) ? zstr__hash_key[i] - seed : zstr__hash_key[i] + seed;
 
-    if ((c & 0xE0) == 0xC0) 
-    {
-        rune = c & 0x1F;
-        len = 2;
-    }
-    else if ((c & 0xF0) == 0xE0) 
+    uint64_t acc[8] = {
+        ZSTR__HASH_PRIME32, 0x9E3779B185EBCA87ULL, 0xC2B2AE3D27D4EB4FULL, 0x165667B19E3779F9ULL,
+        0x85EBCA77C2B2AE63ULL, 0x85EBCA77U, 0x27D4EB2F165667C5ULL, 0xC2B2AE3DU
+    };
+
+    bool avx2 = len >= 1024 && zstr__cpu_has_avx2();
+    const size_t block_len = ZSTR__HASH_STRIPE * ZSTR__HASH_BLOCK;
+    size_t blocks = (len - 1) / block_len;
+
+    for (size_t b = 0; b < blocks; b++)
     {
-        rune = c & 0x0F;
-        len = 3;
+        zstr__hash_accumulate(acc, p + b * block_len, ZSTR__HASH_BLOCK, key, avx2);
+        zstr__hash_scramble_scalar(acc, key + 8);
     }
-    else if ((c & 0xF8) == 0xF0) 
+
+    // Last partial block, then the final (possibly overlapping) stripe.
+    size_t rest = len - blocks * block_len;
+    size_t stripes = (rest - 1) / ZSTR__HASH_STRIPE;
+    zstr__hash_accumulate(acc, p + blocks * block_len, stripes, key, avx2);
+    zstr__hash_accumulate_scalar(acc, p + len - ZSTR__HASH_STRIPE, 1, key + 7);
+
+    uint64_t h = (uint64_t)len * 0x9E3779B185EBCA87ULL;
+    for (size_t i = 0; i < 8; i += 2)
     {
-        rune = c & 0x07;
-        len = 4;
+        h += zstr__mix64(acc[i] ^ key[8 + i], acc[i + 1] ^ key[9 + i]);
     }
-    else 
+    return zstr__hash_avalanche(h);
+}
+
+// Internal: seeded hash of p[0..len). wyhash-style for up to 128 bytes, striped above.
+static inline uint64_t zstr__hash(const char *p, size_t len, uint64_t seed)
+{
+    if (len > 128) return zstr__hash_long(p, len, seed);
+
+    const uint64_t *s = zstr__hash_secret;
+    seed ^= zstr__mix64(seed ^ s[0], s[1]);
+
+    uint64_t a, b;
+    if (len <= 16)
     {
-        *p += 1;
-        return ZSTR_UTF8_INVALID;
+        if (len >= 4)
+        {
+            size_t q = (len >> 3) << 2;
+            a = (zstr__read32(p) << 32) | zstr__read32(p + q);
+            b = (zstr__read32(p + len - 4) << 32) | zstr__read32(p + len - 4 - q);
+        }
+        else if (len > 0)
+        {
+            a = ((uint64_t)(unsigned char)p[0] << 16) | ((uint64_t)(unsigned char)p[len >> 1] << 8) |
+                (unsigned char)p[len - 1];
+            b = 0;
+        }
+        else
+        {
+            a = b = 0;
+        }
     }
-
-    for (int i = 1; i < len; i++) 
+    else
     {
-        unsigned char next = str[i];
-        if ((next & 0xC0) != 0x80) 
+        size_t i = len;
+        const char *q = p;
+        if (i > 48)
         {
-            *p += 1;
-            return ZSTR_UTF8_INVALID;
+            uint64_t see1 = seed, see2 = seed;
+            do
+            {
+                seed = zstr__mix64(zstr__read64(q) ^ s[1], zstr__read64(q + 8) ^ seed);
+                see1 = zstr__mix64(zstr__read64(q + 16) ^ s[2], zstr__read64(q + 24) ^ see1);
+                see2 = zstr__mix64(zstr__read64(q + 32) ^ s[3], zstr__read64(q + 40) ^ see2);
+                q += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
         }
-        rune = (rune << 6) | (next & 0x3F);
+        while (i > 16)
+        {
+            seed = zstr__mix64(zstr__read64(q) ^ s[1], zstr__read64(q + 8) ^ seed);
+            q += 16;
+            i -= 16;
+        }
+        a = zstr__read64(q + i - 16);
+        b = zstr__read64(q + i - 8);
     }
 
-    *p += len;
-    return rune;
-}
-
-// Counts the number of actual UTF-8 Runes, not bytes.
-static inline size_t zstr_count_runes(const zstr *s)
-{
-    const char *ptr = zstr_cstr(s);
-    size_t count = 0;
-    while (*ptr)
+    a ^= s[1];
+    b ^= seed;
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = (__uint128_t)a * b;
+    a = (uint64_t)r;
+    b = (uint64_t)(r >> 64);
+#else
     {
-        zstr_next_rune(&ptr);
-        count++;   
+        uint64_t m = zstr__mix64(a, b);
+        uint64_t lo = a * b;
+        a = lo;
+        b = m ^ lo;
     }
-    return count;
+#endif
+    return zstr__mix64(a ^ s[0] ^ len, b ^ s[1]);
 }
 
-// Validates that the string is strictly valid UTF-8.
-// Rejects Overlong encodings, Surrogates, and out-of-bounds values.
-static inline bool zstr_is_valid_utf8(const zstr *s)
-{
-    const unsigned char *p = (const unsigned char *)zstr_cstr(s);
-    while (*p)
-    {
-        if (*p < 0x80) 
-        {
-            p++; 
-        } 
-        else if ((*p & 0xE0) == 0xC0) // 2-byte.
-        {
-            if (*p < 0xC2) return false; // Overlong.
-            p++;
-            if ((*p & 0xC0) != 0x80) return false; 
-            p++;
-        } 
-        else if ((*p & 0xF0) == 0xE0) // 3-byte.
-        {
-            unsigned char b1 = *p++;
-            unsigned char b2 = *p++;
-            if ((*p & 0xC0) != 0x80) return false; 
-            
-            if (b1 == 0xE0 && b2 < 0xA0) return false; // Overlong.
-            if (b1 == 0xED && b2 >= 0xA0) return false; // Surrogate.
-            if ((b2 & 0xC0) != 0x80) return false;
-            p++;
-        } 
-        else if ((*p & 0xF8) == 0xF0) // 4-byte.
-        {
-            unsigned char b1 = *p++;
-            if (b1 > 0xF4) return false; // > U+10FFFF.
-            
-            unsigned char b2 = *p++;
-            if (b1 == 0xF0 && b2 < 0x90) return false; // Overlong.
-            if (b1 == 0xF4 && b2 >= 0x90) return false; // > U+10FFFF.
-            if ((b2 & 0xC0) != 0x80) return false;
-
-            if ((*p++ & 0xC0) != 0x80) return false; 
-            if ((*p++ & 0xC0) != 0x80) return false; 
-        } 
-        else 
-        {
-            return false;
-        }
-    }
-    return true;
-}
 
+/* Allocators */
 
-/* Views and Slices (Zero-Copy) */
+// Internal: registry storage. GCC and Clang get weak definitions, so every
+// translation unit that includes zstr.h links to the same table, count and
+// thread scope. Elsewhere each translation unit keeps its own copy.
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(_WIN32)
+    #define ZSTR__REGISTRY __attribute__((weak))
+#else
+    #define ZSTR__REGISTRY static
+#endif
 
-// Helper macro to create a view from a string literal.
-#define ZSV(lit) (zstr_view){ .data = (lit), .len = sizeof(lit) -1 }
+ZSTR__REGISTRY zstr_allocator zstr__allocators[ZSTR_MAX_ALLOCATORS];
+ZSTR__REGISTRY uint8_t zstr__allocators_count;
+ZSTR__REGISTRY ZSTR_THREAD_LOCAL uint8_t zstr__allocators_scope;
 
-// Creates a view from a C-string.
-static inline zstr_view zstr_view_from(const char *cstr)
+// Internal: registry of runtime allocators (slot i holds index i + 1).
+static inline zstr_allocator* zstr__allocator_table(void)
 {
-    return (zstr_view){ .data = cstr, .len = strlen(cstr) };
+    return zstr__allocators;
 }
 
-// Creates a view covering the entire zstr.
-static inline zstr_view zstr_as_view(const zstr *s)
+// Internal: number of registered allocators.
+static inline uint8_t* zstr__allocator_count(void)
 {
-    return (zstr_view){ .data = zstr_cstr(s), .len = zstr_len(s) };
+    return &zstr__allocators_count;
 }
 
-// Converts a view back into an owning zstr (allocates).
-static inline zstr zstr_from_view(zstr_view v) 
+// Internal: allocator picked up by new strings on this thread (ZSTR_ALLOC_HEAP = 0 at start).
+static inline uint8_t* zstr__allocator_scope(void)
 {
-    return zstr_from_len(v.data, v.len);
+    return &zstr__allocators_scope;
 }
 
-// Returns a substring view.
-static inline zstr_view zstr_sub(zstr_view v, size_t start, size_t len)
+// Internal: the registered allocator `id`, or NULL if this registry has no such
+// entry (e.g. a string from a translation unit with its own registry).
+static inline const zstr_allocator* zstr__allocator_get(uint8_t id)
 {
-    if (start >= v.len) return (zstr_view){ "", 0 };
-    if (start + len > v.len) len = v.len - start;
-    return (zstr_view){ .data = v.data + start, .len = len };
+    if (id == 0 || id > *zstr__allocator_count()) return NULL;
+    return &zstr__allocator_table()[id - 1];
 }
 
-// Checks if view equals a C-string.
-static inline bool zstr_view_eq(zstr_view v, const char *cstr)
+// Internal: allocator index of a string. Compact short strings carry none
+// and report the thread's current allocator.
+static inline uint8_t zstr__alloc(const zstr *s)
 {
-    if (strlen(cstr) != v.len) return false;
-    return memcmp(v.data, cstr, v.len) == 0;
+#if defined(ZSTR_COMPACT)
+    if (!zstr_is_long(s)) return *zstr__allocator_scope();
+    uint8_t id = ((const unsigned char *)s)[ZSTR_SSO_CAP] & 0x7F;
+    return id == 0x7F ? ZSTR_ALLOC_ARENA : id;
+#else
+    return s->alloc;
+#endif
 }
 
-// Checks if two views are equal.
-static inline bool zstr_view_eq_view(zstr_view a, zstr_view b) 
+// Internal: rebinds the allocator index (no-op for compact short strings).
+static inline void zstr__set_alloc(zstr *s, uint8_t id)
 {
-    if (a.len != b.len) return false;
-    return memcmp(a.data, b.data, a.len) == 0;
+#if defined(ZSTR_COMPACT)
+    if (zstr_is_long(s)) ((unsigned char *)s)[ZSTR_SSO_CAP] = (unsigned char)(ZSTR__LONG_FLAG | (id & 0x7F));
+#else
+    s->alloc = id;
+#endif
 }
 
-// Checks if view starts with prefix.
-static inline bool zstr_view_starts_with(zstr_view v, const char *prefix) 
+// Internal: switches `s` to long mode over a buffer of `cap` + 1 bytes from allocator `id`.
+static inline void zstr__set_long(zstr *s, char *ptr, size_t len, size_t cap, uint8_t id)
 {
-    size_t pre_len = strlen(prefix);
-    if (pre_len > v.len) return false;
-    return memcmp(v.data, prefix, pre_len) == 0;
+#if defined(ZSTR_COMPACT)
+    s->l.ptr = ptr;
+    s->l.len = len;
+    ((unsigned char *)s)[ZSTR_SSO_CAP] = ZSTR__LONG_FLAG;
+    zstr__set_cap(s, cap);
+    zstr__set_alloc(s, id);
+#else
+    s->is_long = 1;
+    s->alloc = id;
+    s->l.ptr = ptr;
+    s->l.len = len;
+    s->l.cap = cap;
+#endif
+    zstr__hash_reset(s);
 }
 
-// Checks if view ends with suffix.
-static inline bool zstr_view_ends_with(zstr_view v, const char *suffix) 
+// Internal: switches `s` to short mode (the caller fills buf/len afterwards).
+static inline void zstr__set_short(zstr *s, uint8_t id)
 {
-    size_t suf_len = strlen(suffix);
-    if (suf_len > v.len) return false;
-    return memcmp(v.data + v.len - suf_len, suffix, suf_len) == 0;
+#if defined(ZSTR_COMPACT)
+    (void)id;
+    s->s.len = 0;
+#else
+    s->is_long = 0;
+    s->alloc = id;
+#endif
 }
 
-// Wrapper for checking if an owning zstr starts with prefix.
-static inline bool zstr_starts_with(const zstr *s, const char *prefix) 
+// Registers a runtime allocator and returns its index (1..ZSTR_MAX_ALLOCATORS),
+// or Z_EINVAL / Z_ENOMEM. Register at startup: the table is not synchronized.
+// It is shared by the whole program on GCC/Clang (see ZSTR__REGISTRY).
+static inline int zstr_allocator_register(const zstr_allocator *a)
 {
-    return zstr_view_starts_with(zstr_as_view(s), prefix);
+    if (!a || !a->alloc_fn || !a->free_fn) return Z_EINVAL;
+
+    uint8_t *count = zstr__allocator_count();
+    if (*count >= ZSTR_MAX_ALLOCATORS) return Z_ENOMEM;
+
+    zstr__allocator_table()[*count] = *a;
+    return ++*count;
 }
 
-// Wrapper for checking if an owning zstr ends with suffix.
-static inline bool zstr_ends_with(const zstr *s, const char *suffix) 
+// Sets the allocator used by strings created on this thread from now on
+// (zstr_init and everything built on it). Returns the previous index.
+static inline int zstr_allocator_use(int id)
 {
-    return zstr_view_ends_with(zstr_as_view(s), suffix);
-}
+    uint8_t *scope = zstr__allocator_scope();
+    uint8_t prev = *scope;
 
+    if (id < 0 || id > *zstr__allocator_count()) return Z_EINVAL;
 
-// Trims whitespace from the start of the view.
-static inline zstr_view zstr_view_lstrip(zstr_view v) 
+    *scope = (uint8_t)id;
+    return prev;
+}
+
+// Returns the allocator index new strings get on this thread.
+static inline int zstr_allocator_current(void)
 {
-    const char *start = v.data;
-    const char *end = v.data + v.len;
-    while (start < end && isspace((unsigned char)*start)) start++;
-    return (zstr_view){ .data = start, .len = (size_t)(end - start) };
+    return *zstr__allocator_scope();
 }
 
-// Trims whitespace from the end of the view.
-static inline zstr_view zstr_view_rstrip(zstr_view v) 
+// Internal: allocates `size` bytes from allocator `id` (NULL for an unknown id).
+static inline char* zstr__mem_alloc(uint8_t id, size_t size)
 {
-    const char *start = v.data;
-    const char *end = v.data + v.len;
-    while (end > start && isspace((unsigned char)*(end - 1))) end--;
-    return (zstr_view){ .data = start, .len = (size_t)(end - start) };
+    if (id == ZSTR_ALLOC_HEAP || id == ZSTR_ALLOC_ARENA) return Z_STR_MALLOC(size);
+
+    const zstr_allocator *a = zstr__allocator_get(id);
+    return a ? (char *)a->alloc_fn(a->ctx, size) : NULL;
 }
 
-// Trims whitespace from both ends.
-static inline zstr_view zstr_view_trim(zstr_view v) 
+// Internal: resizes a buffer owned by allocator `id` (NULL for an unknown id).
+static inline char* zstr__mem_realloc(uint8_t id, char *ptr, size_t old_size, size_t new_size)
 {
-    return zstr_view_lstrip(zstr_view_rstrip(v));
+    if (id == ZSTR_ALLOC_HEAP) return Z_STR_REALLOC(ptr, new_size);
+
+    const zstr_allocator *a = zstr__allocator_get(id);
+    if (!a) return NULL;
+    if (a->realloc_fn) return (char *)a->realloc_fn(a->ctx, ptr, old_size, new_size);
+
+    char *new_ptr = (char *)a->alloc_fn(a->ctx, new_size);
+    if (!new_ptr) return NULL;
+
+    memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+    a->free_fn(a->ctx, ptr, old_size);
+    return new_ptr;
 }
 
-// Converts a view to an integer (simple atoi replacement).
-// Returns true if successful, false if empty or invalid chars found.
-static inline bool zstr_view_to_int(zstr_view v, int *out)
+// Internal: releases a buffer owned by allocator `id` (arena buffers are skipped).
+// A buffer from an unknown id is leaked rather than passed to the wrong allocator.
+static inline void zstr__mem_free(uint8_t id, char *ptr, size_t size)
 {
-    if (v.len == 0) return false;
-    
-    int sign = 1;
-    size_t i = 0;
-    
-    if (v.data[0] == '-') 
-    { 
-        sign = -1; 
-        i++; 
-    }
-    else if (v.data[0] == '+')
+    if (id == ZSTR_ALLOC_ARENA) return;
+    if (id == ZSTR_ALLOC_HEAP)
     {
-        i++;
+        Z_STR_FREE(ptr);
+        return;
     }
-    
-    if (i == v.len) return false;
 
-    int result = 0;
-    for (; i < v.len; i++) 
-    {
-        if (v.data[i] < '0' || v.data[i] > '9') return false; 
-        result = result * 10 + (v.data[i] - '0');
-    }
-    
-    *out = result * sign;
-    return true;
+    const zstr_allocator *a = zstr__allocator_get(id);
+    if (a) a->free_fn(a->ctx, ptr, size);
 }
 
-// Initializes an iterator for splitting a string.
-static inline zstr_split_iter zstr_split_init(zstr_view src, const char *delim) 
+
+/* Creation and Destruction */
+
+// Initializes an empty string {0} bound to the thread's current allocator.
+static inline zstr zstr_init(void)
 {
-    return (zstr_split_iter){
-        .source = src,
-        .delim = zstr_view_from(delim),
-        .current_pos = 0,
-        .finished = false
-    };
+    zstr s;
+    memset(&s, 0, sizeof(zstr));
+    zstr__set_alloc(&s, *zstr__allocator_scope());
+    return s;
 }
 
-// Gets the next part in a split iteration. Returns false when done.
-static inline bool zstr_split_next(zstr_split_iter *it, zstr_view *out_part) 
+// Frees the string if it is on the heap, and resets it to empty.
+// Arena strings are left to their arena (no-op besides the reset).
+static inline void zstr_free(zstr *s)
 {
-    if (it->finished) return false;
+    if (zstr_is_long(s)) zstr__mem_free(zstr__alloc(s), s->l.ptr, zstr__cap(s) + 1);
+    *s = zstr_init();
+}
 
-    const char *start = it->source.data + it->current_pos;
-    size_t remaining = it->source.len - it->current_pos;
-    
-    size_t found_at = remaining;
-    
-    for (size_t i = 0; i <= remaining - it->delim.len; i++) 
-    {
-        if (memcmp(start + i, it->delim.data, it->delim.len) == 0) 
+// Clears the content (sets length to 0) but keeps the allocated capacity.
+static inline void zstr_clear(zstr *s) 
+{
+    zstr_data(s)[0] = '\0';
+    zstr__set_len(s, 0);
+}
+
+
+/* Memory Management */
+
+// Ensures the string has at least `new_cap` capacity.
+// Handles the transition from SSO (Stack) to Long (Heap).
+static inline int zstr_reserve(zstr *s, size_t new_cap)
+{
+    if (new_cap < ZSTR_SSO_CAP) return Z_OK;
+
+    bool is_long = zstr_is_long(s);
+    if (is_long && new_cap <= zstr__cap(s)) return Z_OK;
+
+    uint8_t id = zstr__alloc(s);
+    char *new_ptr;
+    if (is_long && id != ZSTR_ALLOC_ARENA)
+    {
+        new_ptr = zstr__mem_realloc(id, s->l.ptr, zstr__cap(s) + 1, new_cap + 1);
+    }
+    else if (is_long)
+    {
+        // Arena buffers cannot be realloc'd: migrate the string to the thread's allocator.
+        id = *zstr__allocator_scope();
+        new_ptr = zstr__mem_alloc(id, new_cap + 1);
+        if (new_ptr) memcpy(new_ptr, s->l.ptr, s->l.len + 1);
+    }
+    else 
+    {
+        new_ptr = zstr__mem_alloc(id, new_cap + 1);
+        if (new_ptr)
         {
-            found_at = i;
-            break;
+            memcpy(new_ptr, s->s.buf, s->s.len);
+            new_ptr[s->s.len] = '\0';
         }
     }
 
-    if (found_at == remaining) 
+    if (!new_ptr) return Z_ERR;
+
+    // Transition state if we were short before.
+    size_t len = is_long ? s->l.len : s->s.len;
+    zstr__set_long(s, new_ptr, len, new_cap, id);
+
+    return Z_OK;
+}
+
+// Creates a new empty string with pre-allocated capacity on the heap.
+static inline zstr zstr_with_capacity(size_t cap)
+{
+    zstr s = zstr_init();
+    if (cap > ZSTR_SSO_CAP)
+    {
+        zstr_reserve(&s, cap);
+    }
+    return s;
+}
+
+// Reduces heap usage to fit the exact string length (or moves back to SSO if small enough).
+static inline void zstr_shrink_to_fit(zstr *s)
+{
+    if (!zstr_is_long(s)) return;
+
+    uint8_t id = zstr__alloc(s);
+
+    // Downgrade to SSO if possible.
+    if (s->l.len < ZSTR_SSO_CAP)
+    {
+        char temp[ZSTR_SSO_CAP];
+        memcpy(temp, s->l.ptr, s->l.len);
+        temp[s->l.len] = '\0';
+
+        uint8_t old_len = (uint8_t)s->l.len;
+        zstr__mem_free(id, s->l.ptr, zstr__cap(s) + 1);
+
+        zstr__set_short(s, id == ZSTR_ALLOC_ARENA ? *zstr__allocator_scope() : id);
+        memcpy(s->s.buf, temp, old_len + 1);
+        s->s.len = old_len;
+        return;
+    }
+
+    if (s->l.len < zstr__cap(s) && id != ZSTR_ALLOC_ARENA)
     {
-        *out_part = (zstr_view){ .data = start, .len = remaining };
-        it->finished = true;
+        char *new_ptr = zstr__mem_realloc(id, s->l.ptr, zstr__cap(s) + 1, s->l.len + 1);
+        if (new_ptr)
+        {
+            s->l.ptr = new_ptr;
+            zstr__set_cap(s, s->l.len);
+        }
+    }
+}
+
+// Binds the string to allocator `id`, moving a heap buffer over if needed.
+// Later growth and zstr_free go through that allocator.
+static inline int zstr_set_allocator(zstr *s, int id)
+{
+    if (id < 0 || id > *zstr__allocator_count()) return Z_EINVAL;
+    if (zstr__alloc(s) == id) return Z_OK;
+
+#if defined(ZSTR_COMPACT)
+    // Compact short strings have no room for an allocator index: promote them.
+    if (!zstr_is_long(s))
+    {
+        size_t len = s->s.len;
+        char *new_ptr = zstr__mem_alloc((uint8_t)id, ZSTR_SSO_CAP + 1);
+        if (!new_ptr) return Z_ENOMEM;
+
+        memcpy(new_ptr, s->s.buf, len + 1);
+        zstr__set_long(s, new_ptr, len, ZSTR_SSO_CAP, (uint8_t)id);
+        return Z_OK;
+    }
+#endif
+
+    if (zstr_is_long(s))
+    {
+        char *new_ptr = zstr__mem_alloc((uint8_t)id, zstr__cap(s) + 1);
+        if (!new_ptr) return Z_ENOMEM;
+
+        memcpy(new_ptr, s->l.ptr, s->l.len + 1);
+        zstr__mem_free(zstr__alloc(s), s->l.ptr, zstr__cap(s) + 1);
+        s->l.ptr = new_ptr;
+    }
+
+    zstr__set_alloc(s, (uint8_t)id);
+    return Z_OK;
+}
+
+
+/* Construction Helpers */
+
+// Helper: Creates zstr from ptr + explicit len.
+static inline zstr zstr_from_len(const char *ptr, size_t len)
+{
+    zstr s = zstr_init();
+    if (len >= ZSTR_SSO_CAP)
+    {
+        if (zstr_reserve(&s, len) != Z_OK) return s;
+        memcpy(s.l.ptr, ptr, len);
+        s.l.ptr[len] = '\0';
+        s.l.len = len;
     }
     else 
     {
-        *out_part = (zstr_view){ .data = start, .len = found_at };
-        it->current_pos += found_at + it->delim.len;
+        zstr__set_short(&s, zstr__alloc(&s));
+        memcpy(s.s.buf, ptr, len);
+        s.s.buf[len] = '\0';
+        s.s.len = (uint8_t)len;
     }
+    return s;
+}
+
+// Creates a zstr from a standard C-string.
+static inline zstr zstr_from(const char *cstr)
+{
+    return zstr_from_len(cstr, strlen(cstr));
+}
+
+// Macro for compile-time string literals (avoids runtime strlen).
+#define zstr_lit(s) zstr_from_len((s), sizeof(s) - 1)
+
+// Creates a deep copy of a zstr.
+static inline zstr zstr_dup(const zstr *s) 
+{
+    return zstr_from_len(zstr_cstr(s), zstr_len(s));
+}
+
+// Takes ownership of a pointer from the thread's current allocator
+// (Z_STR_MALLOC unless zstr_allocator_use picked another one).
+static inline zstr zstr_own(char *ptr, size_t len, size_t cap)
+{
+    zstr s = zstr_init();
     
-    return true;
+    if (cap < ZSTR_SSO_CAP)
+    {
+        memcpy(s.s.buf, ptr, len);
+        s.s.buf[len] = '\0';
+        s.s.len = (uint8_t)len;
+        zstr__mem_free(zstr__alloc(&s), ptr, cap + 1);
+    }
+    else
+    {
+        zstr__set_long(&s, ptr, len, cap, zstr__alloc(&s));
+    }
+    return s;
 }
 
-#if defined(Z_HAS_CLEANUP) && Z_HAS_CLEANUP
-    #define zstr_autofree  Z_CLEANUP(zstr_free) zstr
-#endif
+// Releases ownership. Returns a pointer the user MUST free with the string's
+// allocator (free() for default strings).
+static inline char* zstr_take(zstr *s)
+{
+    char *ptr;
 
-#ifdef __cplusplus
-} // extern "C"
-#endif
+    uint8_t id = zstr__alloc(s);
 
-/* C++ Integration Layer -> namespace: zstr */
+    if (zstr_is_long(s) && id != ZSTR_ALLOC_ARENA)
+    {
+        ptr = s->l.ptr;
+    }
+    else
+    {
+        // SSO and arena buffers are copied into a fresh block.
+        if (id == ZSTR_ALLOC_ARENA) id = *zstr__allocator_scope();
+        size_t len = zstr_len(s);
+        ptr = zstr__mem_alloc(id, len + 1);
+        if (ptr)
+        {
+            memcpy(ptr, zstr_cstr(s), len);
+            ptr[len] = '\0';
+        }
+    }
+    
+    // Reset the source struct so it doesn't double-free.
+    *s = zstr_init();
+    return ptr;
+}
 
-#ifdef __cplusplus
 
-#include <utility>
-#include <iostream>
-#include <cstring>
-#include <string>
-#include <iterator>
+#if defined(ZSTR_HAS_POSIX)
 
-#if __cplusplus >= 201703L
-#include <string_view>
+// Files at least this large get a sequential read-ahead hint (posix_fadvise).
+#ifndef ZSTR_FADVISE_MIN
+    #define ZSTR_FADVISE_MIN (1024 * 1024)
 #endif
 
-namespace z_str
+// Internal: read() into s until `limit` bytes were added or EOF, retrying EINTR.
+// The capacity must already hold them. Returns the bytes added or -1.
+static inline ssize_t zstr__read_exact(zstr *s, int fd, size_t limit)
 {
-    class string;
+    size_t len = zstr_len(s), got = 0;
+    char *buf = zstr_data(s);
+    while (got < limit)
+    {
+        ssize_t n = read(fd, buf + len + got, limit - got);
+        if (n == 0) break;
+        if (n < 0)
+        {
+            if (errno == EINTR) continue;
+            buf[len + got] = '\0';
+            zstr__set_len(s, len + got);
+            return -1;
+        }
+        got += (size_t)n;
+    }
+    buf[len + got] = '\0';
+    zstr__set_len(s, len + got);
+    return (ssize_t)got;
+}
 
-    class view
+// Appends everything left in `fd` to `s` with read(), growing the buffer as
+// needed (pipes, sockets, /proc files that report size 0). Returns Z_OK,
+// Z_ENOMEM or Z_ERR (errno is kept); bytes read before an error stay in `s`.
+static inline int zstr_read_fd(zstr *s, int fd)
+{
+    for (;;)
     {
-        ::zstr_view inner;
+        size_t len = zstr_len(s);
+        size_t cap = zstr_capacity(s);
+        if (cap - len < 512)
+        {
+            size_t new_cap = cap;
+            while (new_cap - len < 4096) new_cap = Z_GROWTH_FACTOR(new_cap);
+            if (zstr_reserve(s, new_cap) != Z_OK) return Z_ENOMEM;
+            cap = zstr_capacity(s);
+        }
 
-     public:
-        // Iterator traits for view.
-        using value_type      = char;
-        using size_type       = size_t;
-        using difference_type = std::ptrdiff_t;
-        using const_pointer   = const char*;
-        using const_iterator  = const char*;
+        // The long-mode capacity excludes the terminator; SSO keeps one byte for it.
+        size_t room = zstr_is_long(s) ? cap - len : cap - len - 1;
+        ssize_t n = zstr__read_exact(s, fd, room);
+        if (n < 0) return Z_ERR;
+        if ((size_t)n < room) return Z_OK;
+    }
+}
 
-        view() : inner{NULL, 0} {}
-        view(const char *s) : inner(::zstr_view_from(s)) {}
-        view(const char *s, size_t len) : inner{s, len}  {}
-        
-        // Defined later to allow cyclic dependency.
-        view(const string &s);
-        view(const string &&) = delete;
+// Internal: reads the file at `path` into the empty string `s`. Regular files get
+// an exactly sized buffer from fstat and are read() straight into it; files
+// without a usable size (pipes, /proc) go through the growth loop.
+// Returns Z_OK, Z_ENOMEM or Z_ERR (errno is kept).
+static inline int zstr__read_path(zstr *s, const char *path)
+{
+    int flags = O_RDONLY;
+#if defined(O_CLOEXEC)
+    flags |= O_CLOEXEC;
+#endif
+    int fd = open(path, flags);
+    if (fd < 0) return Z_ERR;
 
-        const char *data() const { return inner.data; }
-        size_t size() const      { return inner.len; }
-        size_t length() const    { return inner.len; }
-        bool empty() const       { return inner.len == 0; }
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return Z_ERR;
+    }
+    if (S_ISDIR(st.st_mode))
+    {
+        close(fd);
+        errno = EISDIR;
+        return Z_ERR;
+    }
 
-        const char *begin() const { return inner.data; }
-        const char *end() const   { return inner.data + inner.len; }
+    int rc = Z_OK;
+    if (S_ISREG(st.st_mode) && st.st_size > 0 && (uint64_t)st.st_size < (uint64_t)SIZE_MAX)
+    {
+        size_t size = (size_t)st.st_size;
+#if defined(POSIX_FADV_SEQUENTIAL)
+        if (size >= ZSTR_FADVISE_MIN) posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        if (zstr_reserve(s, size) != Z_OK) rc = Z_ENOMEM;
+        else if (zstr__read_exact(s, fd, size) < 0) rc = Z_ERR;
+        else if (zstr_len(s) == size)
+        {
+            // Usual case: a probe read confirms EOF, so the buffer stays exact.
+            char probe[256];
+            ssize_t n;
+            while ((n = read(fd, probe, sizeof(probe))) < 0 && errno == EINTR) {}
+            if (n < 0) rc = Z_ERR;
+            else if (n > 0)
+            {
+                // The file grew since fstat.
+                if (zstr_reserve(s, size + (size_t)n) != Z_OK) rc = Z_ENOMEM;
+                else
+                {
+                    memcpy(zstr_data(s) + size, probe, (size_t)n);
+                    zstr_data(s)[size + (size_t)n] = '\0';
+                    zstr__set_len(s, size + (size_t)n);
+                    rc = zstr_read_fd(s, fd);
+                }
+            }
+        }
+    }
+    else
+    {
+        rc = zstr_read_fd(s, fd);
+    }
 
-        char operator[](size_t idx) const { return inner.data[idx]; }
+    int err = errno;
+    close(fd);
+    errno = err;
+    return rc;
+}
+
+// Reads an entire file into a zstr. Returns empty on failure.
+// POSIX: exact sizing with fstat + read(); pipes and /proc files also work.
+static inline zstr zstr_read_file(const char *path)
+{
+    zstr s = zstr_init();
+    if (zstr__read_path(&s, path) != Z_OK) zstr_free(&s);
+    return s;
+}
+
+#else
+
+// Reads an entire file into a zstr. Returns empty on failure.
+static inline zstr zstr_read_file(const char *path)
+{
+    zstr s = zstr_init();
+    FILE *f = fopen(path, "rb"); 
+    if (!f) return s;
+
+    fseek(f, 0, SEEK_END);
+    long length = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    // Pedantic check.
+    if (length <= 0 || (sizeof(long) > sizeof(size_t) && (size_t)length > (size_t)-1))
+    {
+        fclose(f);
+        return s;
+    }
+
+    if (zstr_reserve(&s, (size_t)length) != Z_OK) 
+    {
+        fclose(f);
+        return s;
+    }
+
+    char *buf = zstr_data(&s);
+    size_t read_count = fread(buf, 1, (size_t)length, f);
+    buf[read_count] = '\0';
+
+    zstr__set_len(&s, read_count);
+
+    fclose(f);
+    return s;
+}
+
+#endif // ZSTR_HAS_POSIX
+
+// Appends a single character to the string.
+static inline int zstr_push_char(zstr *s, char c)
+{
+    size_t len = zstr_len(s);
+    if (len + 1 >= zstr_capacity(s))
+    {
+        size_t cap = zstr_capacity(s);
+        size_t new_cap = Z_GROWTH_FACTOR(cap);
+
+        if (zstr_reserve(s, new_cap) != Z_OK) return Z_ERR;
+    }
+
+    char *p = zstr_data(s);
+    p[len] = c;
+    p[len + 1] = '\0';
+
+    zstr__set_len(s, zstr_len(s) + 1);
+
+    return Z_OK;    
+}
+
+// Removes and returns the last character of the string.
+static inline char zstr_pop_char(zstr *s)
+{
+    size_t len = zstr_len(s);
+    if (len == 0) return '\0';
+    
+    char *p = zstr_data(s);
+    char c = p[len - 1];
+    p[len - 1] = '\0';
+    
+    zstr__set_len(s, zstr_len(s) - 1);
+    
+    return c;
+}
+
+// Appends a raw char buffer of known length.
+static inline int zstr_cat_len(zstr *s, const char *src, size_t src_len)
+{
+    size_t cur_len = zstr_len(s);
+    size_t req_cap = cur_len + src_len;
+
+    if (req_cap >= zstr_capacity(s)) 
+    {
+        size_t new_cap = zstr_capacity(s);
+        // Logic fixed: starting cap is 23. If we grow, we just multiply.
+        // We do not fallback to 32 because 23 > 0.
+        if (new_cap == 0) new_cap = ZSTR_SSO_CAP;
+        
+        while (new_cap <= req_cap) new_cap = Z_GROWTH_FACTOR(new_cap);
+        
+        if (zstr_reserve(s, new_cap) != Z_OK) return Z_ERR;
+    }
+
+    char *dest = zstr_data(s);
+    memcpy(dest + cur_len, src, src_len);
+    dest[cur_len + src_len] = '\0';
+
+    zstr__set_len(s, zstr_len(s) + src_len);
+
+    return Z_OK;
+}
+
+// Appends a null-terminated C-string.
+static inline int zstr_cat(zstr *s, const char *cstr)
+{
+    return zstr_cat_len(s, cstr, strlen(cstr));
+}
+
+// Joins an array of strings with a delimiter.
+static inline zstr zstr_join(const char **strings, size_t count, const char *delim)
+{
+    zstr s = zstr_init();
+    if (count == 0) return s;
+
+    size_t delim_len = strlen(delim);
+    size_t total_len = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        total_len += strlen(strings[i]);
+        if (i < count - 1) total_len += delim_len;
+    }
+
+    if (zstr_reserve(&s, total_len) != Z_OK) return s;
+    
+    for (size_t i = 0; i < count; i++)
+    {
+        zstr_cat(&s, strings[i]);
+        if (i < count - 1) zstr_cat(&s, delim);
+    }
+    return s;
+}
+
+// Formats a string (printf style) and appends it.
+ZSTR_PRINTF_ATTR(2, 3)
+static inline int zstr_fmt(zstr *s, const char *fmt, ...) 
+{
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+
+    if (len < 0) return Z_ERR;
+
+    size_t cur_len = zstr_len(s);
+    size_t req_cap = cur_len + len;
+    
+    if (req_cap >= zstr_capacity(s)) 
+    {
+        if (zstr_reserve(s, req_cap) != Z_OK) return Z_ERR;
+    }
+
+    va_start(args, fmt);
+    char *buf = zstr_data(s);
+    vsnprintf(buf + cur_len, len + 1, fmt, args);
+    va_end(args);
+
+    zstr__set_len(s, zstr_len(s) + len);
+
+    return Z_OK;
+}
+
+
+/* Arena Strings */
+
+// Creates an empty arena. Blocks of `block_size` bytes (0 = ZSTR_ARENA_BLOCK_SIZE)
+// are obtained lazily on the first allocation.
+static inline zstr_arena zstr_arena_init(size_t block_size)
+{
+    zstr_arena a;
+    a.head = NULL;
+    a.block_size = block_size ? block_size : ZSTR_ARENA_BLOCK_SIZE;
+    a.reserved = 0;
+    return a;
+}
+
+// Internal: start of a block's data area.
+static inline char* zstr__arena_block_data(zstr_arena_block *b)
+{
+    return (char *)(b + 1);
+}
+
+// Allocates `size` bytes (8-byte aligned) from the arena. Returns NULL on failure.
+static inline void* zstr_arena_alloc(zstr_arena *a, size_t size)
+{
+    size = (size + 7) & ~(size_t)7;
+
+    zstr_arena_block *b = a->head;
+    if (b && b->cap - b->used >= size)
+    {
+        void *p = zstr__arena_block_data(b) + b->used;
+        b->used += size;
+        return p;
+    }
+
+    size_t cap = size > a->block_size ? size : a->block_size;
+    zstr_arena_block *nb = (zstr_arena_block *)Z_MALLOC(sizeof(zstr_arena_block) + cap);
+    if (!nb) return NULL;
+
+    nb->cap = cap;
+    nb->used = size;
+    a->reserved += cap;
+
+    if (b && size > a->block_size)
+    {
+        // Oversized request: keep bumping from the current block afterwards.
+        nb->next = b->next;
+        b->next = nb;
+    }
+    else
+    {
+        nb->next = b;
+        a->head = nb;
+    }
+    return zstr__arena_block_data(nb);
+}
+
+// Internal: grows the most recent allocation in place when it sits at the top of the head block.
+static inline bool zstr__arena_try_extend(zstr_arena *a, const char *ptr, size_t old_size, size_t new_size)
+{
+    zstr_arena_block *b = a->head;
+    if (!b) return false;
+
+    old_size = (old_size + 7) & ~(size_t)7;
+    new_size = (new_size + 7) & ~(size_t)7;
+
+    char *top = zstr__arena_block_data(b) + b->used;
+    if (ptr + old_size != top || b->used - old_size + new_size > b->cap) return false;
+
+    b->used = b->used - old_size + new_size;
+    return true;
+}
+
+// Releases every block except the newest one, which is kept for reuse.
+// All strings allocated from the arena become invalid.
+static inline void zstr_arena_reset(zstr_arena *a)
+{
+    zstr_arena_block *b = a->head;
+    if (!b) return;
+
+    zstr_arena_block *rest = b->next;
+    while (rest)
+    {
+        zstr_arena_block *next = rest->next;
+        a->reserved -= rest->cap;
+        Z_FREE(rest);
+        rest = next;
+    }
+    b->next = NULL;
+    b->used = 0;
+}
+
+// Releases all arena memory.
+static inline void zstr_arena_free(zstr_arena *a)
+{
+    zstr_arena_block *b = a->head;
+    while (b)
+    {
+        zstr_arena_block *next = b->next;
+        Z_FREE(b);
+        b = next;
+    }
+    a->head = NULL;
+    a->reserved = 0;
+}
+
+// Ensures `s` has at least `new_cap` capacity, taking any new buffer from the arena.
+// Heap strings are moved into the arena (their old buffer is freed).
+static inline int zstr_reserve_arena(zstr_arena *a, zstr *s, size_t new_cap)
+{
+    if (new_cap < ZSTR_SSO_CAP) return Z_OK;
+    if (zstr_is_long(s) && new_cap <= zstr__cap(s)) return Z_OK;
+
+    if (zstr_is_long(s) && zstr__alloc(s) == ZSTR_ALLOC_ARENA &&
+        zstr__arena_try_extend(a, s->l.ptr, zstr__cap(s) + 1, new_cap + 1))
+    {
+        zstr__set_cap(s, new_cap);
+        return Z_OK;
+    }
+
+    char *new_ptr = (char *)zstr_arena_alloc(a, new_cap + 1);
+    if (!new_ptr) return Z_ERR;
+
+    size_t len = zstr_len(s);
+    memcpy(new_ptr, zstr_cstr(s), len);
+    new_ptr[len] = '\0';
+
+    if (zstr_is_long(s)) zstr__mem_free(zstr__alloc(s), s->l.ptr, zstr__cap(s) + 1);
+
+    zstr__set_long(s, new_ptr, len, new_cap, ZSTR_ALLOC_ARENA);
+    return Z_OK;
+}
+
+// Creates a zstr from ptr + len, using the arena when it does not fit in SSO.
+static inline zstr zstr_from_len_arena(zstr_arena *a, const char *ptr, size_t len)
+{
+    zstr s = zstr_init();
+    if (len < ZSTR_SSO_CAP) return zstr_from_len(ptr, len);
+    if (zstr_reserve_arena(a, &s, len) != Z_OK) return s;
+
+    memcpy(s.l.ptr, ptr, len);
+    s.l.ptr[len] = '\0';
+    s.l.len = len;
+    return s;
+}
+
+// Creates a zstr from a C-string, using the arena when it does not fit in SSO.
+static inline zstr zstr_from_arena(zstr_arena *a, const char *cstr)
+{
+    return zstr_from_len_arena(a, cstr, strlen(cstr));
+}
+
+// Appends a buffer of known length; growth is served by the arena
+// (extended in place when `s` is the arena's most recent allocation).
+static inline int zstr_cat_len_arena(zstr_arena *a, zstr *s, const char *src, size_t src_len)
+{
+    size_t cur_len = zstr_len(s);
+    size_t req_cap = cur_len + src_len;
+
+    if (req_cap >= zstr_capacity(s))
+    {
+        size_t new_cap = zstr_capacity(s);
+        while (new_cap <= req_cap) new_cap = Z_GROWTH_FACTOR(new_cap);
+
+        if (zstr_reserve_arena(a, s, new_cap) != Z_OK) return Z_ERR;
+    }
+
+    char *dest = zstr_data(s);
+    memcpy(dest + cur_len, src, src_len);
+    dest[cur_len + src_len] = '\0';
+
+    zstr__set_len(s, zstr_len(s) + src_len);
+
+    return Z_OK;
+}
+
+// Formats a string (printf style) and appends it, growing through the arena.
+ZSTR_PRINTF_ATTR(3, 4)
+static inline int zstr_fmt_arena(zstr_arena *a, zstr *s, const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+
+    if (len < 0) return Z_ERR;
+
+    size_t cur_len = zstr_len(s);
+    size_t req_cap = cur_len + len;
+
+    if (req_cap >= zstr_capacity(s))
+    {
+        if (zstr_reserve_arena(a, s, req_cap) != Z_OK) return Z_ERR;
+    }
+
+    va_start(args, fmt);
+    vsnprintf(zstr_data(s) + cur_len, len + 1, fmt, args);
+    va_end(args);
+
+    zstr__set_len(s, zstr_len(s) + len);
+
+    return Z_OK;
+}
+
+
+/* Shared Strings (Reference Counted) */
+
+// Internal: allocation size of a shared block holding `len` bytes.
+static inline size_t zstr__shared_size(size_t len)
+{
+    return sizeof(zstr_shared_hdr) + len + 1;
+}
+
+// Internal: bytes of a shared block.
+static inline char* zstr__shared_data(zstr_shared_hdr *h)
+{
+    return (char *)(h + 1);
+}
+
+// Returns an empty shared string (no allocation).
+static inline zstr_shared zstr_shared_init(void)
+{
+    zstr_shared s;
+    s.h = NULL;
+    return s;
+}
+
+// Creates a shared string from ptr + len with a reference count of 1.
+// Empty input (or allocation failure) yields the empty shared string.
+static inline zstr_shared zstr_shared_from_len(const char *ptr, size_t len)
+{
+    zstr_shared s = zstr_shared_init();
+    if (len == 0) return s;
+
+    uint8_t id = *zstr__allocator_scope();
+    zstr_shared_hdr *h = (zstr_shared_hdr *)zstr__mem_alloc(id, zstr__shared_size(len));
+    if (!h) return s;
+
+    h->refs = 1;
+    h->len = len;
+    h->alloc = id;
+    memcpy(zstr__shared_data(h), ptr, len);
+    zstr__shared_data(h)[len] = '\0';
+
+    s.h = h;
+    return s;
+}
+
+// Creates a shared string from a C-string.
+static inline zstr_shared zstr_shared_from(const char *cstr)
+{
+    return zstr_shared_from_len(cstr, strlen(cstr));
+}
+
+// Creates a shared string holding a copy of `s`.
+static inline zstr_shared zstr_share(const zstr *s)
+{
+    return zstr_shared_from_len(zstr_cstr(s), zstr_len(s));
+}
+
+// Returns another reference to the same bytes (O(1), atomic increment).
+static inline zstr_shared zstr_shared_retain(zstr_shared s)
+{
+    if (s.h) ZSTR__ATOMIC_INC(&s.h->refs);
+    return s;
+}
+
+// Drops one reference and frees the block with the last one. Resets `s` to empty.
+static inline void zstr_shared_release(zstr_shared *s)
+{
+    zstr_shared_hdr *h = s->h;
+    s->h = NULL;
+
+    if (h && ZSTR__ATOMIC_DEC(&h->refs) == 0)
+    {
+        zstr__mem_free(h->alloc, (char *)h, zstr__shared_size(h->len));
+    }
+}
+
+// Returns the length in bytes.
+static inline size_t zstr_shared_len(zstr_shared s)
+{
+    return s.h ? s.h->len : 0;
+}
+
+// Returns the null-terminated bytes. Valid while any reference lives.
+static inline const char* zstr_shared_cstr(zstr_shared s)
+{
+    return s.h ? zstr__shared_data(s.h) : "";
+}
+
+// Borrows a view of the bytes. Valid while any reference lives.
+static inline zstr_view zstr_shared_view(zstr_shared s)
+{
+    zstr_view v;
+    v.data = zstr_shared_cstr(s);
+    v.len = zstr_shared_len(s);
+    return v;
+}
+
+// Returns the current number of references (0 for the empty string).
+static inline size_t zstr_shared_refcount(zstr_shared s)
+{
+    return s.h ? ZSTR__ATOMIC_LOAD(&s.h->refs) : 0;
+}
+
+// Copy-on-write promotion: consumes one reference and returns a mutable zstr.
+// The sole owner gets the block itself back (no allocation); otherwise the bytes are copied.
+static inline zstr zstr_shared_promote(zstr_shared *s)
+{
+    zstr_shared_hdr *h = s->h;
+    if (!h) return zstr_init();
+
+    size_t len = h->len;
+    if (len < ZSTR_SSO_CAP || ZSTR__ATOMIC_LOAD(&h->refs) != 1)
+    {
+        zstr out = zstr_from_len(zstr__shared_data(h), len);
+        zstr_shared_release(s);
+        return out;
+    }
+
+    // Unique owner: slide the bytes over the header and adopt the block.
+    uint8_t id = h->alloc;
+    size_t cap = zstr__shared_size(len) - 1;
+    char *block = (char *)h;
+    memmove(block, zstr__shared_data(h), len + 1);
+    s->h = NULL;
+
+    zstr out = zstr_init();
+    zstr__set_long(&out, block, len, cap, id);
+    return out;
+}
+
+
+/* In-Place Transformations */
+
+// Removes leading and trailing whitespace in-place.
+static inline void zstr_trim(zstr *s)
+{
+    if (zstr_len(s) == 0) return;
+
+    char *start = zstr_data(s);
+    char *end = start + zstr_len(s) - 1;
+
+    while (end >= start && isspace((unsigned char)*end))
+    {
+        *end = '\0';
+        end--;
+    }
+
+    size_t final_len = (end >= start) ? (size_t)(end - start + 1) : 0;
+    
+    char *new_start = start;
+    while (new_start <= end && isspace((unsigned char)*new_start))
+    {
+        new_start++;
+    }
+    
+    // Adjust final length based on left trim.
+    final_len = (new_start <= end) ? (size_t)(end - new_start + 1) : 0;
+
+    if (new_start > start)
+    {
+        memmove(start, new_start, final_len);
+        start[final_len] = '\0';
+    }
+
+    zstr__set_len(s, final_len);
+}
+
+
+/* Comparison */
+
+// Checks equality between two zstr objects (faster than strcmp).
+static inline bool zstr_eq(const zstr *a, const zstr *b)
+{
+    size_t la = zstr_len(a);
+    size_t lb = zstr_len(b);
+    if (la != lb) return false;
+    return memcmp(zstr_cstr(a), zstr_cstr(b), la) == 0;
+}
+
+// Checks equality ignoring case (ASCII only).
+static inline bool zstr_eq_ignore_case(const zstr *a, const zstr *b)
+{
+    size_t len = zstr_len(a);
+    if (len != zstr_len(b)) return false;
+    
+    const char *p1 = zstr_cstr(a);
+    const char *p2 = zstr_cstr(b);
+    
+    for (size_t i = 0; i < len; i++) {
+        if (tolower((unsigned char)p1[i]) != tolower((unsigned char)p2[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Standard strcmp behavior for zstr objects.
+static inline int zstr_cmp(const zstr *a, const zstr *b)
+{
+    return strcmp(zstr_cstr(a), zstr_cstr(b));
+}
+
+
+/* Hashing */
+
+// Hashes the bytes of a view (64-bit, non-cryptographic, length-aware).
+// Values are not stable across versions or byte orders: do not persist them.
+static inline uint64_t zstr_view_hash(zstr_view v)
+{
+    return zstr__hash(v.data, v.len, 0);
+}
+
+// Seeded variant. Use a random per-process seed for tables fed by untrusted keys (HashDoS).
+static inline uint64_t zstr_view_hash_seeded(zstr_view v, uint64_t seed)
+{
+    return zstr__hash(v.data, v.len, seed);
+}
+
+// Hashes the contents of a zstr (same value as zstr_view_hash of its view).
+// With ZSTR_CACHE_HASH, heap strings keep the result until the next mutation.
+// The cache is logically mutable. It is read and written with relaxed atomics,
+// so concurrent readers of a const string may race to store the same value
+// without a data race. Writes through an old zstr_data() pointer after hashing
+// are not seen; call zstr_data() again before writing.
+static inline uint64_t zstr_hash(const zstr *s)
+{
+#if defined(ZSTR_CACHE_HASH)
+    if (zstr_is_long(s))
+    {
+        uint64_t *cache = &((zstr *)s)->l.hash;
+        uint64_t h = ZSTR__RELAXED_LOAD64(cache);
+        if (h) return h;
+        h = zstr__hash(s->l.ptr, s->l.len, 0);
+        ZSTR__RELAXED_STORE64(cache, h);
+        return h;
+    }
+#endif
+    return zstr__hash(zstr_cstr(s), zstr_len(s), 0);
+}
+
+// Seeded variant of zstr_hash.
+static inline uint64_t zstr_hash_seeded(const zstr *s, uint64_t seed)
+{
+    return zstr__hash(zstr_cstr(s), zstr_len(s), seed);
+}
+
+
+/* Search */
+
+// Returns the index of the first occurrence of needle in the view, or -1 if not found.
+// Both sides are length-bounded, so embedded NULs are searched like any other byte.
+static inline ptrdiff_t zstr_view_find(zstr_view v, zstr_view needle)
+{
+    const char *found = zstr__memmem(v.data, v.len, needle.data, needle.len);
+    if (!found) return -1;
+    return (ptrdiff_t)(found - v.data);
+}
+
+// Returns true if the view contains the needle.
+static inline bool zstr_view_contains(zstr_view v, zstr_view needle)
+{
+    return zstr_view_find(v, needle) != -1;
+}
+
+// Returns the index of the first occurrence of a needle of known length, or -1 if not found.
+static inline ptrdiff_t zstr_find_len(const zstr *s, const char *needle, size_t needle_len)
+{
+    zstr_view hay = { zstr_cstr(s), zstr_len(s) };
+    zstr_view ndl = { needle, needle_len };
+    return zstr_view_find(hay, ndl);
+}
+
+// Returns the index of the first occurrence of needle, or -1 if not found.
+static inline ptrdiff_t zstr_find(const zstr *s, const char *needle)
+{
+    return zstr_find_len(s, needle, strlen(needle));
+}
+
+// Returns true if the string contains the substring.
+static inline bool zstr_contains(const zstr *s, const char *needle)
+{
+    return zstr_find(s, needle) != -1;
+}
+
+// Compiles a needle once for repeated searches. The needle memory is borrowed.
+// Short needles use the SIMD filter anchored on their two rarest bytes, long
+// needles use Two-Way with a Horspool shift table; both are precomputed here.
+static inline zstr_searcher zstr_searcher_init(zstr_view needle)
+{
+    zstr_searcher sr;
+    memset(&sr, 0, sizeof(sr));
+    sr.needle = needle;
+    if (needle.len < 2) return sr;
+
+    const unsigned char *n = (const unsigned char *)needle.data;
+
+    if (needle.len <= ZSTR_TWOWAY_THRESHOLD || needle.len > UINT32_MAX)
+    {
+        // Rarest byte first, then the rarest byte with a different value.
+        size_t r1 = 0;
+        for (size_t i = 1; i < needle.len; i++)
+        {
+            if (zstr__byte_rank[n[i]] < zstr__byte_rank[n[r1]]) r1 = i;
+        }
+
+        size_t r2 = (r1 == 0) ? needle.len - 1 : 0;
+        for (size_t i = 0; i < needle.len; i++)
+        {
+            if (i == r1 || n[i] == n[r1]) continue;
+            if (n[r2] == n[r1] || zstr__byte_rank[n[i]] < zstr__byte_rank[n[r2]]) r2 = i;
+        }
+
+        sr.rare1 = r1;
+        sr.rare2 = r2;
+    }
+
+    if (needle.len > ZSTR_TWOWAY_THRESHOLD)
+    {
+        sr.suffix = zstr__critical_factorization(n, needle.len, &sr.period);
+        for (size_t i = 0; i < 256; i++) sr.shift[i] = (uint32_t)needle.len;
+        for (size_t i = 0; i < needle.len; i++) sr.shift[n[i]] = (uint32_t)(needle.len - i - 1);
+    }
+    return sr;
+}
+
+// Returns the index of the first match at or after `from`, or -1 if not found.
+static inline ptrdiff_t zstr_searcher_find_from(const zstr_searcher *sr, zstr_view hay, size_t from)
+{
+    const size_t nlen = sr->needle.len;
+    const char *found;
+
+    if (from > hay.len || nlen > hay.len - from) return -1;
+    if (nlen == 0) return (ptrdiff_t)from;
+
+    if (nlen == 1)
+    {
+        found = (const char *)memchr(hay.data + from, sr->needle.data[0], hay.len - from);
+    }
+    else if (nlen > ZSTR_TWOWAY_THRESHOLD && nlen <= UINT32_MAX)
+    {
+        found = zstr__find_twoway_shift(hay.data, hay.len, from, sr->needle.data, nlen,
+                                        sr->suffix, sr->period, sr->shift);
+    }
+    else
+    {
+        found = zstr__find_filter(hay.data, hay.len, from, sr->needle.data, nlen, sr->rare1, sr->rare2);
+    }
+
+    if (!found) return -1;
+    return (ptrdiff_t)(found - hay.data);
+}
+
+// Returns the index of the first match in the view, or -1 if not found.
+static inline ptrdiff_t zstr_searcher_find(const zstr_searcher *sr, zstr_view hay)
+{
+    return zstr_searcher_find_from(sr, hay, 0);
+}
+
+// Initializes an iterator over all non-overlapping matches in `src`.
+static inline zstr_search_iter zstr_searcher_iter(const zstr_searcher *sr, zstr_view src)
+{
+    zstr_search_iter it;
+    it.searcher = sr;
+    it.source = src;
+    it.pos = 0;
+    it.finished = false;
+    return it;
+}
+
+// Stores the offset of the next match in `out_pos`. Returns false when done.
+static inline bool zstr_search_next(zstr_search_iter *it, size_t *out_pos)
+{
+    if (it->finished) return false;
+
+    ptrdiff_t idx = zstr_searcher_find_from(it->searcher, it->source, it->pos);
+    if (idx < 0)
+    {
+        it->finished = true;
+        return false;
+    }
+
+    *out_pos = (size_t)idx;
+    // Empty needles match at every offset; step by one to make progress.
+    it->pos = (size_t)idx + (it->searcher->needle.len ? it->searcher->needle.len : 1);
+    return true;
+}
+
+// Internal: match offsets kept on the stack by zstr__replace_grow before it allocates.
+#define ZSTR__REPLACE_INLINE 32
+
+// Internal: replacement no longer than the target, written in place. The write
+// cursor never passes the read cursor, so the bytes the searcher still has to
+// scan are never overwritten. `idx` is the first match.
+static inline void zstr__replace_shrink(zstr *s, const zstr_searcher *sr, zstr_view hay, size_t idx,
+                                        const char *repl, size_t repl_len)
+{
+    const size_t target_len = sr->needle.len;
+    char *p = zstr_data(s);
+    size_t read = 0, write = 0;
+    ptrdiff_t next;
+
+    do
+    {
+        size_t gap = idx - read;
+        if (write != read) memmove(p + write, p + read, gap);
+        write += gap;
+        memcpy(p + write, repl, repl_len);
+        write += repl_len;
+        read = idx + target_len;
+        next = zstr_searcher_find_from(sr, hay, read);
+        idx = (size_t)next;
+    } while (next >= 0);
+
+    size_t tail = hay.len - read;
+    if (write != read) memmove(p + write, p + read, tail);
+    write += tail;
+    p[write] = '\0';
+    zstr__set_len(s, write);
+}
+
+// Internal: replacement longer than the target. Records every match offset,
+// reserves the final length once and fills the string from the back, moving
+// each segment right by the growth of the matches before it.
+static inline int zstr__replace_grow(zstr *s, const zstr_searcher *sr, zstr_view hay, size_t idx,
+                                     const char *repl, size_t repl_len)
+{
+    const size_t target_len = sr->needle.len;
+    size_t local[ZSTR__REPLACE_INLINE];
+    size_t *pos = local;
+    size_t count = 0, cap = ZSTR__REPLACE_INLINE;
+    ptrdiff_t next = (ptrdiff_t)idx;
+    int rc = Z_OK;
+
+    while (next >= 0)
+    {
+        if (count == cap)
+        {
+            size_t new_cap = Z_GROWTH_FACTOR(cap);
+            size_t *grown = (pos == local) ? (size_t *)Z_MALLOC(new_cap * sizeof(size_t))
+                                           : (size_t *)Z_REALLOC(pos, new_cap * sizeof(size_t));
+            if (!grown)
+            {
+                rc = Z_ENOMEM;
+                break;
+            }
+            if (pos == local) memcpy(grown, local, sizeof(local));
+            pos = grown;
+            cap = new_cap;
+        }
+        pos[count++] = (size_t)next;
+        next = zstr_searcher_find_from(sr, hay, (size_t)next + target_len);
+    }
+
+    size_t grow = repl_len - target_len;
+    if (rc == Z_OK && grow > (SIZE_MAX - 1 - hay.len) / count) rc = Z_ERR;
+    size_t new_len = hay.len + count * grow;
+    if (rc == Z_OK && zstr_reserve(s, new_len) != Z_OK) rc = Z_ENOMEM;
+
+    if (rc == Z_OK)
+    {
+        char *p = zstr_data(s);
+        size_t end = hay.len, out = new_len;
+        p[new_len] = '\0';
+        for (size_t k = count; k-- > 0;)
+        {
+            size_t seg = pos[k] + target_len;
+            out -= end - seg;
+            memmove(p + out, p + seg, end - seg);
+            out -= repl_len;
+            memcpy(p + out, repl, repl_len);
+            end = pos[k];
+        }
+        zstr__set_len(s, new_len);
+    }
+
+    if (pos != local) Z_FREE(pos);
+    return rc;
+}
+
+// Replaces every non-overlapping occurrence of a target of known length.
+// Embedded NULs are allowed in all three strings. The matches are found in a
+// single pass with a compiled searcher; a replacement no longer than the target
+// is written in place without allocating. Returns Z_ERR for an empty target or
+// if the result length overflows, Z_ENOMEM if the buffer cannot grow.
+static inline int zstr_replace_len(zstr *s, const char *target, size_t target_len,
+                                   const char *replacement, size_t repl_len)
+{
+    if (!target || target_len == 0) return Z_ERR;
+    if (!replacement)
+    {
+        // NULL deletes the matches, as in zstr_replace.
+        replacement = "";
+        repl_len = 0;
+    }
+
+    zstr_view needle = { target, target_len };
+    zstr_searcher sr = zstr_searcher_init(needle);
+    zstr_view hay = { zstr_cstr(s), zstr_len(s) };
+    ptrdiff_t idx = zstr_searcher_find(&sr, hay);
+    if (idx < 0) return Z_OK;
+
+    // A target or replacement taken from the string itself is copied out first.
+    char *copy = NULL;
+    bool alias_t = target >= hay.data && target <= hay.data + hay.len;
+    bool alias_r = repl_len && replacement >= hay.data && replacement <= hay.data + hay.len;
+    if (alias_t || alias_r)
+    {
+        copy = (char *)Z_MALLOC(target_len + repl_len);
+        if (!copy) return Z_ENOMEM;
+        memcpy(copy, target, target_len);
+        if (repl_len) memcpy(copy + target_len, replacement, repl_len);
+        needle.data = copy;
+        sr.needle = needle;
+        replacement = copy + target_len;
+    }
+
+    int rc = Z_OK;
+    if (repl_len <= target_len) zstr__replace_shrink(s, &sr, hay, (size_t)idx, replacement, repl_len);
+    else rc = zstr__replace_grow(s, &sr, hay, (size_t)idx, replacement, repl_len);
+
+    Z_FREE(copy);
+    return rc;
+}
+
+// Replaces all occurrences of "target" with "replacement" (C-strings).
+// This may reallocate the string if the size grows.
+static inline int zstr_replace(zstr *s, const char *target, const char *replacement)
+{
+    if (!target) return Z_ERR;
+    return zstr_replace_len(s, target, strlen(target), replacement,
+                            replacement ? strlen(replacement) : 0);
+}
+
+
+/* UTF-8 Support */
+
+// Decodes the next rune from the pointer and advances the pointer.
+// Returns ZSTR_UTF8_INVALID (0xFFFD) on error.
+static inline uint32_t zstr_next_rune(const char **p)
+{
+    const unsigned char *str = (const unsigned char *)*p;
+    unsigned char c = *str;
+
+    if (c == '\0') return 0;
+
+    if (c < 0x80) 
+    {
+        *p += 1;
+        return c;
+    }
+
+    uint32_t rune = 0;
+    int len = 0;
+
+    if ((c & 0xE0) == 0xC0) 
+    {
+        rune = c & 0x1F;
+        len = 2;
+    }
+    else if ((c & 0xF0) == 0xE0) 
+    {
+        rune = c & 0x0F;
+        len = 3;
+    }
+    else if ((c & 0xF8) == 0xF0) 
+    {
+        rune = c & 0x07;
+        len = 4;
+    }
+    else 
+    {
+        *p += 1;
+        return ZSTR_UTF8_INVALID;
+    }
+
+    for (int i = 1; i < len; i++) 
+    {
+        unsigned char next = str[i];
+        if ((next & 0xC0) != 0x80) 
+        {
+            *p += 1;
+            return ZSTR_UTF8_INVALID;
+        }
+        rune = (rune << 6) | (next & 0x3F);
+    }
+
+    *p += len;
+    return rune;
+}
+
+// Counts the UTF-8 runes (not bytes) in a view, as the bytes that are not
+// continuation bytes. Exact for valid UTF-8; embedded NULs count as runes.
+static inline size_t zstr_view_count_runes(zstr_view v)
+{
+    return zstr__count_runes(v.data, v.len);
+}
+
+// Counts the number of actual UTF-8 Runes, not bytes (see zstr_view_count_runes).
+static inline size_t zstr_count_runes(const zstr *s)
+{
+    return zstr__count_runes(zstr_cstr(s), zstr_len(s));
+}
+
+// Validates that the view is strictly valid UTF-8: rejects overlong encodings,
+// surrogates, values above U+10FFFF and truncated sequences. Length-bounded,
+// so embedded NULs are accepted. Uses SIMD lookups on 32-byte blocks.
+static inline bool zstr_view_is_valid_utf8(zstr_view v)
+{
+    return zstr__utf8_valid(v.data, v.len);
+}
+
+// Validates that the string is strictly valid UTF-8 (see zstr_view_is_valid_utf8).
+static inline bool zstr_is_valid_utf8(const zstr *s)
+{
+    return zstr__utf8_valid(zstr_cstr(s), zstr_len(s));
+}
+
+
+/* Rune Index (UTF-8) */
+
+// Runes between two samples of a zstr_rune_index.
+#ifndef ZSTR_RUNE_INDEX_STRIDE
+    #define ZSTR_RUNE_INDEX_STRIDE 64
+#endif
+
+// Initializes an empty index.
+static inline void zstr_rune_index_init(zstr_rune_index *idx)
+{
+    memset(idx, 0, sizeof(*idx));
+}
+
+// Frees the samples.
+static inline void zstr_rune_index_free(zstr_rune_index *idx)
+{
+    Z_FREE(idx->offsets);
+    zstr_rune_index_init(idx);
+}
+
+// Internal: records the byte offset of the next sampled rune.
+static inline int zstr__rune_index_push(zstr_rune_index *idx, size_t offset)
+{
+    if (idx->count == idx->cap)
+    {
+        size_t new_cap = Z_GROWTH_FACTOR(idx->cap);
+        size_t *grown = (size_t *)Z_REALLOC(idx->offsets, new_cap * sizeof(size_t));
+        if (!grown) return Z_ENOMEM;
+        idx->offsets = grown;
+        idx->cap = new_cap;
+    }
+    idx->offsets[idx->count++] = offset;
+    return Z_OK;
+}
+
+// Brings the index up to date with `s`. Bytes appended since the last call are
+// indexed incrementally; a string that got shorter is re-indexed from scratch.
+// Any other in-place edit needs zstr_rune_index_build. Each 64-byte block is
+// turned into a rune-start bitmask with SIMD compares; samples are picked out
+// of the mask by bit rank. Returns Z_OK or Z_ENOMEM.
+static inline int zstr_rune_index_update(zstr_rune_index *idx, const zstr *s)
+{
+    const unsigned char *p = (const unsigned char *)zstr_cstr(s);
+    size_t len = zstr_len(s);
+
+    if (len < idx->bytes)
+    {
+        idx->count = 0;
+        idx->runes = 0;
+        idx->bytes = 0;
+    }
+
+    size_t i = idx->bytes;
+    size_t runes = idx->runes;
+    while (i < len)
+    {
+        size_t block = (len - i < 64) ? len - i : 64;
+        uint64_t starts = zstr__rune_starts64(p + i, block);
+        size_t n = zstr__popcount64(starts);
+        size_t next = idx->count * (size_t)ZSTR_RUNE_INDEX_STRIDE;
+
+        // Most blocks hold no sample and are only counted.
+        while (runes + n > next)
+        {
+            size_t at = i + zstr__select64(starts, (unsigned)(next - runes));
+            if (zstr__rune_index_push(idx, at) != Z_OK)
+            {
+                // Keep the samples taken so far consistent: stop before this block.
+                idx->count = (runes + ZSTR_RUNE_INDEX_STRIDE - 1) / ZSTR_RUNE_INDEX_STRIDE;
+                idx->runes = runes;
+                idx->bytes = i;
+                return Z_ENOMEM;
+            }
+            next += ZSTR_RUNE_INDEX_STRIDE;
+        }
+        runes += n;
+        i += block;
+    }
+
+    idx->runes = runes;
+    idx->bytes = len;
+    return Z_OK;
+}
+
+// Rebuilds the index for `s` from scratch. Returns Z_OK or Z_ENOMEM.
+static inline int zstr_rune_index_build(zstr_rune_index *idx, const zstr *s)
+{
+    idx->count = 0;
+    idx->runes = 0;
+    idx->bytes = 0;
+    return zstr_rune_index_update(idx, s);
+}
+
+// Number of runes in the indexed string (as of the last update).
+static inline size_t zstr_rune_index_len(const zstr_rune_index *idx)
+{
+    return idx->runes;
+}
+
+// Byte offset of rune `rune`: one sample lookup, then 64-byte rune-start masks
+// over fewer than ZSTR_RUNE_INDEX_STRIDE runes. Returns the indexed length for rune >= the count.
+static inline size_t zstr_rune_index_offset(const zstr_rune_index *idx, const zstr *s, size_t rune)
+{
+    if (rune >= idx->runes) return idx->bytes;
+
+    const unsigned char *p = (const unsigned char *)zstr_cstr(s);
+    size_t pos = idx->offsets[rune / ZSTR_RUNE_INDEX_STRIDE];
+    size_t k = rune % ZSTR_RUNE_INDEX_STRIDE;
+    for (;;)
+    {
+        size_t block = (idx->bytes - pos < 64) ? idx->bytes - pos : 64;
+        uint64_t starts = zstr__rune_starts64(p + pos, block);
+        size_t n = zstr__popcount64(starts);
+        if (k < n) return pos + zstr__select64(starts, (unsigned)k);
+        k -= n;
+        pos += block;
+    }
+}
+
+// Rune number of the rune containing byte `offset` (the rune count for offsets
+// at or past the indexed length).
+static inline size_t zstr_rune_index_rune_at(const zstr_rune_index *idx, const zstr *s, size_t offset)
+{
+    if (offset >= idx->bytes) return idx->runes;
+    if (idx->count == 0 || offset < idx->offsets[0]) return 0;
+
+    // Last sample at or before `offset`.
+    size_t lo = 0, hi = idx->count;
+    while (hi - lo > 1)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (idx->offsets[mid] <= offset) lo = mid;
+        else hi = mid;
+    }
+
+    size_t base = idx->offsets[lo];
+    size_t n = zstr__count_runes(zstr_cstr(s) + base, offset - base + 1);
+    return lo * (size_t)ZSTR_RUNE_INDEX_STRIDE + n - 1;
+}
+
+// Zero-copy slice of `len` runes starting at rune `start` (both clamped).
+static inline zstr_view zstr_rune_index_sub(const zstr_rune_index *idx, const zstr *s, size_t start, size_t len)
+{
+    zstr_view v;
+    size_t b0 = zstr_rune_index_offset(idx, s, start);
+    size_t end = (start < idx->runes && len < idx->runes - start) ? start + len : idx->runes;
+    size_t b1 = zstr_rune_index_offset(idx, s, end);
+    v.data = zstr_cstr(s) + b0;
+    v.len = b1 > b0 ? b1 - b0 : 0;
+    return v;
+}
+
+
+/* UTF-16 / UTF-32 Transcoding */
+
+// Internal: decodes the non-ASCII sequence at p[i] with the strict rules of
+// zstr_is_valid_utf8. Returns its length (2..4) and stores the code point, or
+// returns 0 for an invalid or truncated sequence.
+static inline size_t zstr__utf8_decode(const unsigned char *p, size_t len, size_t i, uint32_t *cp)
+{
+    unsigned char c = p[i];
+    if (c < 0xC2 || c > 0xF4) return 0;
+
+    // Two-byte sequences (Latin, Greek, Cyrillic, Hebrew, Arabic) need no range table.
+    if (c < 0xE0)
+    {
+        if (len - i < 2 || (p[i + 1] & 0xC0) != 0x80) return 0;
+        *cp = ((uint32_t)(c & 0x1F) << 6) | (p[i + 1] & 0x3F);
+        return 2;
+    }
+
+    size_t n = (c < 0xE0) ? 2 : (c < 0xF0) ? 3 : 4;
+    if (len - i < n) return 0;
+
+    unsigned char lo = 0x80, hi = 0xBF, c1 = p[i + 1];
+    if (c == 0xE0) lo = 0xA0;
+    else if (c == 0xED) hi = 0x9F;
+    else if (c == 0xF0) lo = 0x90;
+    else if (c == 0xF4) hi = 0x8F;
+    if (c1 < lo || c1 > hi) return 0;
+
+    uint32_t v = (uint32_t)(c & (0x7F >> n));
+    for (size_t k = 1; k < n; k++)
+    {
+        unsigned char b = p[i + k];
+        if ((b & 0xC0) != 0x80) return 0;
+        v = (v << 6) | (b & 0x3F);
+    }
+    *cp = v;
+    return n;
+}
+
+// Internal: true if the next 16 bytes are ASCII (the caller checks the bounds).
+static inline bool zstr__ascii16(const unsigned char *p)
+{
+#if defined(ZSTR_HAS_SSE2)
+    return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)p)) == 0;
+#else
+    return zstr__ascii8(p) && zstr__ascii8(p + 8);
+#endif
+}
+
+// Number of UTF-16 code units needed for a valid UTF-8 view: one per rune,
+// plus one more for each 4-byte sequence (surrogate pair).
+static inline size_t zstr_view_utf16_len(zstr_view v)
+{
+    const unsigned char *p = (const unsigned char *)v.data;
+    size_t n = zstr__count_runes(v.data, v.len), i = 0;
+    for (; i + 8 <= v.len; i += 8)
+    {
+        uint64_t w;
+        memcpy(&w, p + i, 8);
+        // Bit 7 of each byte survives only if bits 7..4 are set (a 4-byte lead).
+        uint64_t four = (w & (w << 1) & (w << 2) & (w << 3)) & 0x8080808080808080ULL;
+        n += (size_t)(((four >> 7) * 0x0101010101010101ULL) >> 56);
+    }
+    for (; i < v.len; i++) n += (p[i] >= 0xF0);
+    return n;
+}
+
+// Number of UTF-32 code units needed for a valid UTF-8 view (its rune count).
+static inline size_t zstr_view_utf32_len(zstr_view v)
+{
+    return zstr__count_runes(v.data, v.len);
+}
+
+// Converts UTF-8 to UTF-16 (native endianness) into dst[0..cap), validating in
+// the same pass. Blocks of 16 ASCII bytes are widened with SIMD unpacks. Stops
+// at the first invalid sequence (Z_EINVAL, `read` = its byte offset) or when
+// dst is full (Z_EOOB); `written` counts the units stored either way. Size dst
+// with zstr_view_utf16_len.
+static inline zstr_transcode_result zstr_view_to_utf16(zstr_view src, uint16_t *dst, size_t cap)
+{
+    const unsigned char *p = (const unsigned char *)src.data;
+    const size_t len = src.len;
+    zstr_transcode_result res = { Z_OK, 0, 0 };
+    size_t i = 0, o = 0;
+
+    while (i < len)
+    {
+        if (i + 16 <= len && cap - o >= 16 && zstr__ascii16(p + i))
+        {
+#if defined(ZSTR_HAS_SSE2)
+            __m128i in = _mm_loadu_si128((const __m128i *)(p + i));
+            _mm_storeu_si128((__m128i *)(dst + o), _mm_unpacklo_epi8(in, _mm_setzero_si128()));
+            _mm_storeu_si128((__m128i *)(dst + o + 8), _mm_unpackhi_epi8(in, _mm_setzero_si128()));
+#else
+            for (size_t k = 0; k < 16; k++) dst[o + k] = p[i + k];
+#endif
+            i += 16;
+            o += 16;
+            continue;
+        }
+
+        // One character at a time until the next block. A byte never yields more
+        // than one unit, so the room check is skipped when the window fits.
+        size_t stop = (len - i < 16) ? len : i + 16;
+        bool room = cap - o >= stop - i + 3;
+        while (i < stop)
+        {
+            uint32_t cp = p[i];
+            size_t n = 1;
+            if (cp >= 0x80 && (n = zstr__utf8_decode(p, len, i, &cp)) == 0)
+            {
+                res.status = Z_EINVAL;
+                goto out;
+            }
+
+            size_t units = (cp >= 0x10000) ? 2 : 1;
+            if (!room && cap - o < units)
+            {
+                res.status = Z_EOOB;
+                goto out;
+            }
+            if (units == 1)
+            {
+                dst[o++] = (uint16_t)cp;
+            }
+            else
+            {
+                cp -= 0x10000;
+                dst[o++] = (uint16_t)(0xD800 + (cp >> 10));
+                dst[o++] = (uint16_t)(0xDC00 + (cp & 0x3FF));
+            }
+            i += n;
+        }
+    }
+
+out:
+    res.read = i;
+    res.written = o;
+    return res;
+}
+
+// Converts UTF-8 to UTF-32 into dst[0..cap), validating in the same pass (see
+// zstr_view_to_utf16 for the result). Size dst with zstr_view_utf32_len.
+static inline zstr_transcode_result zstr_view_to_utf32(zstr_view src, uint32_t *dst, size_t cap)
+{
+    const unsigned char *p = (const unsigned char *)src.data;
+    const size_t len = src.len;
+    zstr_transcode_result res = { Z_OK, 0, 0 };
+    size_t i = 0, o = 0;
+
+    while (i < len)
+    {
+        if (i + 16 <= len && cap - o >= 16 && zstr__ascii16(p + i))
+        {
+#if defined(ZSTR_HAS_SSE2)
+            const __m128i zero = _mm_setzero_si128();
+            __m128i in = _mm_loadu_si128((const __m128i *)(p + i));
+            __m128i lo = _mm_unpacklo_epi8(in, zero);
+            __m128i hi = _mm_unpackhi_epi8(in, zero);
+            _mm_storeu_si128((__m128i *)(dst + o), _mm_unpacklo_epi16(lo, zero));
+            _mm_storeu_si128((__m128i *)(dst + o + 4), _mm_unpackhi_epi16(lo, zero));
+            _mm_storeu_si128((__m128i *)(dst + o + 8), _mm_unpacklo_epi16(hi, zero));
+            _mm_storeu_si128((__m128i *)(dst + o + 12), _mm_unpackhi_epi16(hi, zero));
+#else
+            for (size_t k = 0; k < 16; k++) dst[o + k] = p[i + k];
+#endif
+            i += 16;
+            o += 16;
+            continue;
+        }
+
+        size_t stop = (len - i < 16) ? len : i + 16;
+        bool room = cap - o >= stop - i + 3;
+        while (i < stop)
+        {
+            uint32_t cp = p[i];
+            size_t n = 1;
+            if (cp >= 0x80 && (n = zstr__utf8_decode(p, len, i, &cp)) == 0)
+            {
+                res.status = Z_EINVAL;
+                goto out;
+            }
+            if (!room && o == cap)
+            {
+                res.status = Z_EOOB;
+                goto out;
+            }
+            dst[o++] = cp;
+            i += n;
+        }
+    }
+
+out:
+    res.read = i;
+    res.written = o;
+    return res;
+}
+
+// Converts the string to UTF-16 (see zstr_view_to_utf16).
+static inline zstr_transcode_result zstr_to_utf16(const zstr *s, uint16_t *dst, size_t cap)
+{
+    zstr_view v = { zstr_cstr(s), zstr_len(s) };
+    return zstr_view_to_utf16(v, dst, cap);
+}
+
+// Converts the string to UTF-32 (see zstr_view_to_utf32).
+static inline zstr_transcode_result zstr_to_utf32(const zstr *s, uint32_t *dst, size_t cap)
+{
+    zstr_view v = { zstr_cstr(s), zstr_len(s) };
+    return zstr_view_to_utf32(v, dst, cap);
+}
+
+// Internal: UTF-8 length of a code point (valid scalar values only).
+static inline size_t zstr__utf8_width(uint32_t cp)
+{
+    return (cp < 0x80) ? 1 : (cp < 0x800) ? 2 : (cp < 0x10000) ? 3 : 4;
+}
+
+// Internal: writes a valid scalar value as UTF-8 and returns its length.
+static inline size_t zstr__utf8_encode(char *out, uint32_t cp)
+{
+    unsigned char *o = (unsigned char *)out;
+    if (cp < 0x80)
+    {
+        o[0] = (unsigned char)cp;
+        return 1;
+    }
+    if (cp < 0x800)
+    {
+        o[0] = (unsigned char)(0xC0 | (cp >> 6));
+        o[1] = (unsigned char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000)
+    {
+        o[0] = (unsigned char)(0xE0 | (cp >> 12));
+        o[1] = (unsigned char)(0x80 | ((cp >> 6) & 0x3F));
+        o[2] = (unsigned char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    o[0] = (unsigned char)(0xF0 | (cp >> 18));
+    o[1] = (unsigned char)(0x80 | ((cp >> 12) & 0x3F));
+    o[2] = (unsigned char)(0x80 | ((cp >> 6) & 0x3F));
+    o[3] = (unsigned char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+// Internal: UTF-8 length of utf16[*i] (advancing past a surrogate pair), or 0
+// for an unpaired surrogate.
+static inline size_t zstr__utf16_width(const uint16_t *src, size_t n, size_t *i)
+{
+    uint32_t u = src[*i];
+    if (u < 0xD800 || u > 0xDFFF)
+    {
+        (*i)++;
+        return zstr__utf8_width(u);
+    }
+    if (u > 0xDBFF || *i + 1 == n || src[*i + 1] < 0xDC00 || src[*i + 1] > 0xDFFF) return 0;
+    *i += 2;
+    return 4;
+}
+
+// Appends UTF-16 (native endianness) as UTF-8. A first pass validates the
+// surrogate pairs and computes the exact UTF-8 length, 8 units per step with
+// SIMD compares; the length is reserved once and the second pass encodes,
+// packing runs of 8 ASCII units. Nothing is appended on error: Z_EINVAL
+// (`read` = offset of the unpaired surrogate) or Z_ENOMEM. On success
+// `written` is the number of bytes appended.
+static inline zstr_transcode_result zstr_cat_utf16(zstr *s, const uint16_t *src, size_t n)
+{
+    zstr_transcode_result res = { Z_OK, 0, 0 };
+    size_t total = 0, i = 0;
+
+    while (i < n)
+    {
+#if defined(ZSTR_HAS_SSE2)
+        if (i + 8 <= n)
+        {
+            // Each unit is 1 byte, +1 from U+0080, +1 from U+0800. Blocks with
+            // surrogates take the scalar path, which checks the pairing.
+            const __m128i zero = _mm_setzero_si128();
+            __m128i in = _mm_loadu_si128((const __m128i *)(src + i));
+            __m128i surr = _mm_cmpeq_epi16(_mm_and_si128(in, _mm_set1_epi16((short)0xF800)),
+                                           _mm_set1_epi16((short)0xD800));
+            if (_mm_movemask_epi8(surr) == 0)
+            {
+                uint32_t ascii = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_subs_epu16(in, _mm_set1_epi16(0x7F)), zero));
+                uint32_t small = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_subs_epu16(in, _mm_set1_epi16(0x7FF)), zero));
+                total += 8 + (16 - zstr__popcount32(ascii)) / 2 + (16 - zstr__popcount32(small)) / 2;
+                i += 8;
+                continue;
+            }
+        }
+#endif
+        size_t stop = (n - i < 8) ? n : i + 8;
+        while (i < stop)
+        {
+            size_t w = zstr__utf16_width(src, n, &i);
+            if (w == 0)
+            {
+                res.status = Z_EINVAL;
+                res.read = i;
+                return res;
+            }
+            total += w;
+        }
+    }
+
+    size_t len = zstr_len(s);
+    if (total > SIZE_MAX - 1 - len || zstr_reserve(s, len + total) != Z_OK)
+    {
+        res.status = Z_ENOMEM;
+        return res;
+    }
+
+    char *out = zstr_data(s) + len;
+    size_t o = 0;
+    i = 0;
+    while (i < n)
+    {
+#if defined(ZSTR_HAS_SSE2)
+        if (i + 8 <= n)
+        {
+            __m128i in = _mm_loadu_si128((const __m128i *)(src + i));
+            __m128i high = _mm_and_si128(in, _mm_set1_epi16((short)0xFF80));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) == 0xFFFF)
+            {
+                _mm_storel_epi64((__m128i *)(out + o), _mm_packus_epi16(in, in));
+                o += 8;
+                i += 8;
+                continue;
+            }
+        }
+#endif
+        size_t stop = (n - i < 8) ? n : i + 8;
+        while (i < stop)
+        {
+            uint32_t u = src[i++];
+            if (u >= 0xD800 && u <= 0xDBFF)
+            {
+                u = 0x10000 + ((u - 0xD800) << 10) + (uint32_t)(src[i++] - 0xDC00);
+            }
+            o += zstr__utf8_encode(out + o, u);
+        }
+    }
+
+    out[o] = '\0';
+    zstr__set_len(s, len + total);
+    res.read = n;
+    res.written = total;
+    return res;
+}
+
+// Appends UTF-32 as UTF-8. Values above U+10FFFF and surrogates are rejected
+// with Z_EINVAL (`read` = their index) before anything is appended. Sized and
+// encoded in two passes like zstr_cat_utf16.
+static inline zstr_transcode_result zstr_cat_utf32(zstr *s, const uint32_t *src, size_t n)
+{
+    zstr_transcode_result res = { Z_OK, 0, 0 };
+    size_t total = 0;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        uint32_t u = src[i];
+        if (u > 0x10FFFF || (u >= 0xD800 && u <= 0xDFFF))
+        {
+            res.status = Z_EINVAL;
+            res.read = i;
+            return res;
+        }
+        total += zstr__utf8_width(u);
+    }
+
+    size_t len = zstr_len(s);
+    if (total > SIZE_MAX - 1 - len || zstr_reserve(s, len + total) != Z_OK)
+    {
+        res.status = Z_ENOMEM;
+        return res;
+    }
+
+    char *out = zstr_data(s) + len;
+    size_t o = 0, i = 0;
+    while (i < n)
+    {
+#if defined(ZSTR_HAS_SSE2)
+        if (i + 8 <= n)
+        {
+            __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+            __m128i b = _mm_loadu_si128((const __m128i *)(src + i + 4));
+            __m128i high = _mm_or_si128(_mm_and_si128(a, _mm_set1_epi32(~0x7F)),
+                                        _mm_and_si128(b, _mm_set1_epi32(~0x7F)));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(high, _mm_setzero_si128())) == 0xFFFF)
+            {
+                // Values are < 0x80, so the signed 32->16 pack cannot saturate.
+                __m128i w = _mm_packs_epi32(a, b);
+                _mm_storel_epi64((__m128i *)(out + o), _mm_packus_epi16(w, w));
+                o += 8;
+                i += 8;
+                continue;
+            }
+        }
+#endif
+        o += zstr__utf8_encode(out + o, src[i]);
+        i++;
+    }
+
+    out[o] = '\0';
+    zstr__set_len(s, len + total);
+    res.read = n;
+    res.written = total;
+    return res;
+}
+
+
+/* Case Conversion */
+
+// Simple (1:1) Unicode case mappings, generated from the Unicode 14.0 UCD.
+// Two-level lookup: zstr__case_stage1[cp >> 6] selects a 64-entry block of
+// zstr__case_stage2, whose entries index the (lower, upper) deltas. Code
+// points at or above ZSTR__CASE_LIMIT have no mapping.
+#define ZSTR__CASE_LIMIT 0x1E980U
+#define ZSTR__CASE_BLOCKS 1958
+
+static const uint8_t zstr__case_stage1[ZSTR__CASE_BLOCKS] = {
+      0,   1,   2,   3,   4,   5,   6,   7,   8,   9,  10,   0,   0,  11,  12,  13,
+     14,  15,  16,  17,  18,  19,  20,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,  21,  22,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  23,  24,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,  25,   0,   0,  26,  27,   0,  28,  28,  29,  28,  30,  31,  32,  33,
+      0,   0,   0,   0,  34,  35,  36,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,  37,  38,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+     39,  40,  28,  41,  42,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,  43,  44,   0,  45,  46,  47,  48,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  49,  50,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  51,  52,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+     53,  54,  55,  56,   0,  57,  58,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,  59,  60,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,  61,  62,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,  63,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,  64,  65,
+};
+
+static const uint8_t zstr__case_stage2[] = {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   0,   0,   0,   0,   0,
+      0,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+      2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   3,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+      1,   1,   1,   1,   1,   1,   1,   0,   1,   1,   1,   1,   1,   1,   1,   0,
+      2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+      2,   2,   2,   2,   2,   2,   2,   0,   2,   2,   2,   2,   2,   2,   2,   4,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      7,   8,   5,   6,   5,   6,   5,   6,   0,   5,   6,   5,   6,   5,   6,   5,
+      6,   5,   6,   5,   6,   5,   6,   5,   6,   0,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   9,   5,   6,   5,   6,   5,   6,  10,
+     11,  12,   5,   6,   5,   6,  13,   5,   6,  14,  14,   5,   6,   0,  15,  16,
+     17,   5,   6,  14,  18,  19,  20,  21,   5,   6,  22,   0,  20,  23,  24,  25,
+      5,   6,   5,   6,   5,   6,  26,   5,   6,  26,   0,   0,   5,   6,  26,   5,
+      6,  27,  27,   5,   6,   5,   6,  28,   5,   6,   0,   0,   5,   6,   0,  29,
+      0,   0,   0,   0,  30,  31,  32,  30,  31,  32,  30,  31,  32,   5,   6,   5,
+      6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,  33,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      0,  30,  31,  32,   5,   6,  34,  35,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+     36,   0,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   0,   0,   0,   0,   0,   0,  37,   5,   6,  38,  39,  40,
+     40,   5,   6,  41,  42,  43,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+     44,  45,  46,  47,  48,   0,  49,  49,   0,  50,   0,  51,  52,   0,   0,   0,
+     49,  53,   0,  54,   0,  55,  56,   0,  57,  58,  56,  59,  60,   0,   0,  58,
+      0,  61,  62,   0,   0,  63,   0,   0,   0,   0,   0,   0,   0,  64,   0,   0,
+     65,   0,  66,  65,   0,   0,   0,  67,  65,  68,  69,  69,  70,   0,   0,   0,
+      0,   0,  71,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,  72,  73,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,  74,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      5,   6,   5,   6,   0,   0,   5,   6,   0,   0,   0,  24,  24,  24,   0,  75,
+      0,   0,   0,   0,   0,   0,  76,   0,  77,  77,  77,   0,  78,   0,  79,  79,
+      0,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+      1,   1,   0,   1,   1,   1,   1,   1,   1,   1,   1,   1,  80,  81,  81,  81,
+      0,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+      2,   2,  82,   2,   2,   2,   2,   2,   2,   2,   2,   2,  83,  84,  84,  85,
+     86,  87,   0,   0,   0,  88,  89,  90,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+     91,  92,  93,  94,  95,  96,   0,   5,   6,  97,   5,   6,   0,  36,  36,  36,
+     98,  98,  98,  98,  98,  98,  98,  98,  98,  98,  98,  98,  98,  98,  98,  98,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+      2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+      2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+     92,  92,  92,  92,  92,  92,  92,  92,  92,  92,  92,  92,  92,  92,  92,  92,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   0,   0,   0,   0,   0,   0,   0,   0,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+     99,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6, 100,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      0, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101,
+    101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101,
+    101, 101, 101, 101, 101, 101, 101,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102,
+    102, 102, 102, 102, 102, 102, 102,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    103, 103, 103, 103, 103, 103, 103, 103, 103, 103, 103, 103, 103, 103, 103, 103,
+    103, 103, 103, 103, 103, 103, 103, 103, 103, 103, 103, 103, 103, 103, 103, 103,
+    103, 103, 103, 103, 103, 103,   0, 103,   0,   0,   0,   0,   0, 103,   0,   0,
+    104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,
+    104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104,   0,   0, 104, 104, 104,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105,
+    105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105,
+    105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105,
+    105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105,
+    105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105,
+     85,  85,  85,  85,  85,  85,   0,   0,  90,  90,  90,  90,  90,  90,   0,   0,
+    106, 107, 108, 109, 109, 110, 111, 112, 113,   0,   0,   0,   0,   0,   0,   0,
+    114, 114, 114, 114, 114, 114, 114, 114, 114, 114, 114, 114, 114, 114, 114, 114,
+    114, 114, 114, 114, 114, 114, 114, 114, 114, 114, 114, 114, 114, 114, 114, 114,
+    114, 114, 114, 114, 114, 114, 114, 114, 114, 114, 114,   0,   0, 114, 114, 114,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0, 115,   0,   0,   0, 116,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0, 117,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   0,   0,   0,   0,   0, 118,   0,   0, 119,   0,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+    120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121, 121, 121, 121,
+    120, 120, 120, 120, 120, 120,   0,   0, 121, 121, 121, 121, 121, 121,   0,   0,
+    120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121, 121, 121, 121,
+    120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121, 121, 121, 121,
+    120, 120, 120, 120, 120, 120,   0,   0, 121, 121, 121, 121, 121, 121,   0,   0,
+      0, 120,   0, 120,   0, 120,   0, 120,   0, 121,   0, 121,   0, 121,   0, 121,
+    120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121, 121, 121, 121,
+    122, 122, 123, 123, 123, 123, 124, 124, 125, 125, 126, 126, 127, 127,   0,   0,
+    120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121, 121, 121, 121,
+    120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121, 121, 121, 121,
+    120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121, 121, 121, 121,
+    120, 120,   0, 128,   0,   0,   0,   0, 121, 121, 129, 129, 130,   0, 131,   0,
+      0,   0,   0, 128,   0,   0,   0,   0, 132, 132, 132, 132, 130,   0,   0,   0,
+    120, 120,   0,   0,   0,   0,   0,   0, 121, 121, 133, 133,   0,   0,   0,   0,
+    120, 120,   0,   0,   0,  93,   0,   0, 121, 121, 134, 134,  97,   0,   0,   0,
+      0,   0,   0, 128,   0,   0,   0,   0, 135, 135, 136, 136, 130,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0, 137,   0,   0,   0, 138, 139,   0,   0,   0,   0,
+      0,   0, 140,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0, 141,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    142, 142, 142, 142, 142, 142, 142, 142, 142, 142, 142, 142, 142, 142, 142, 142,
+    143, 143, 143, 143, 143, 143, 143, 143, 143, 143, 143, 143, 143, 143, 143, 143,
+      0,   0,   0,   5,   6,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0, 144, 144, 144, 144, 144, 144, 144, 144, 144, 144,
+    144, 144, 144, 144, 144, 144, 144, 144, 144, 144, 144, 144, 144, 144, 144, 144,
+    145, 145, 145, 145, 145, 145, 145, 145, 145, 145, 145, 145, 145, 145, 145, 145,
+    145, 145, 145, 145, 145, 145, 145, 145, 145, 145,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101,
+    101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101,
+    101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101, 101,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102,
+    102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102, 102,
+      5,   6, 146, 147, 148, 149, 150,   5,   6,   5,   6,   5,   6, 151, 152, 153,
+    154,   0,   5,   6,   0,   5,   6,   0,   0,   0,   0,   0,   0,   0, 155, 155,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   0,   0,   0,   0,   0,   0,   0,   5,   6,   5,   6,   0,
+      0,   0,   5,   6,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    156, 156, 156, 156, 156, 156, 156, 156, 156, 156, 156, 156, 156, 156, 156, 156,
+    156, 156, 156, 156, 156, 156, 156, 156, 156, 156, 156, 156, 156, 156, 156, 156,
+    156, 156, 156, 156, 156, 156,   0, 156,   0,   0,   0,   0,   0, 156,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      0,   0,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   5,   6,   5,   6, 157,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   0,   0,   0,   5,   6, 158,   0,   0,
+      5,   6,   5,   6, 159,   0,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6,   5,   6,   5,   6,   5,   6, 160, 161, 162, 163, 160,   0,
+    164, 165, 166, 167,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,   5,   6,
+      5,   6,   5,   6, 168, 169, 170,   5,   6,   5,   6,   0,   0,   0,   0,   0,
+      5,   6,   0,   0,   0,   0,   5,   6,   5,   6,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   5,   6,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0, 171,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172,
+    172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172,
+    172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172,
+    172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172,
+    172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172, 172,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   0,   0,   0,   0,   0,
+      0,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+      2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    173, 173, 173, 173, 173, 173, 173, 173, 173, 173, 173, 173, 173, 173, 173, 173,
+    173, 173, 173, 173, 173, 173, 173, 173, 173, 173, 173, 173, 173, 173, 173, 173,
+    173, 173, 173, 173, 173, 173, 173, 173, 174, 174, 174, 174, 174, 174, 174, 174,
+    174, 174, 174, 174, 174, 174, 174, 174, 174, 174, 174, 174, 174, 174, 174, 174,
+    174, 174, 174, 174, 174, 174, 174, 174, 174, 174, 174, 174, 174, 174, 174, 174,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    173, 173, 173, 173, 173, 173, 173, 173, 173, 173, 173, 173, 173, 173, 173, 173,
+    173, 173, 173, 173, 173, 173, 173, 173, 173, 173, 173, 173, 173, 173, 173, 173,
+    173, 173, 173, 173,   0,   0,   0,   0, 174, 174, 174, 174, 174, 174, 174, 174,
+    174, 174, 174, 174, 174, 174, 174, 174, 174, 174, 174, 174, 174, 174, 174, 174,
+    174, 174, 174, 174, 174, 174, 174, 174, 174, 174, 174, 174,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+    175, 175, 175, 175, 175, 175, 175, 175, 175, 175, 175,   0, 175, 175, 175, 175,
+    175, 175, 175, 175, 175, 175, 175, 175, 175, 175, 175,   0, 175, 175, 175, 175,
+    175, 175, 175,   0, 175, 175,   0, 176, 176, 176, 176, 176, 176, 176, 176, 176,
+    176, 176,   0, 176, 176, 176, 176, 176, 176, 176, 176, 176, 176, 176, 176, 176,
+    176, 176,   0, 176, 176, 176, 176, 176, 176, 176,   0, 176, 176,   0,   0,   0,
+     78,  78,  78,  78,  78,  78,  78,  78,  78,  78,  78,  78,  78,  78,  78,  78,
+     78,  78,  78,  78,  78,  78,  78,  78,  78,  78,  78,  78,  78,  78,  78,  78,
+     78,  78,  78,  78,  78,  78,  78,  78,  78,  78,  78,  78,  78,  78,  78,  78,
+     78,  78,  78,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+     83,  83,  83,  83,  83,  83,  83,  83,  83,  83,  83,  83,  83,  83,  83,  83,
+     83,  83,  83,  83,  83,  83,  83,  83,  83,  83,  83,  83,  83,  83,  83,  83,
+     83,  83,  83,  83,  83,  83,  83,  83,  83,  83,  83,  83,  83,  83,  83,  83,
+     83,  83,  83,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+      2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+      2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,   1,
+      2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+      2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,   2,
+    177, 177, 177, 177, 177, 177, 177, 177, 177, 177, 177, 177, 177, 177, 177, 177,
+    177, 177, 177, 177, 177, 177, 177, 177, 177, 177, 177, 177, 177, 177, 177, 177,
+    177, 177, 178, 178, 178, 178, 178, 178, 178, 178, 178, 178, 178, 178, 178, 178,
+    178, 178, 178, 178, 178, 178, 178, 178, 178, 178, 178, 178, 178, 178, 178, 178,
+    178, 178, 178, 178,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,
+};
+
+static const int32_t zstr__case_delta[][2] = {
+    { 0, 0 }, { 32, 0 }, { 0, -32 }, { 0, 743 },
+    { 0, 121 }, { 1, 0 }, { 0, -1 }, { -199, 0 },
+    { 0, -232 }, { -121, 0 }, { 0, -300 }, { 0, 195 },
+    { 210, 0 }, { 206, 0 }, { 205, 0 }, { 79, 0 },
+    { 202, 0 }, { 203, 0 }, { 207, 0 }, { 0, 97 },
+    { 211, 0 }, { 209, 0 }, { 0, 163 }, { 213, 0 },
+    { 0, 130 }, { 214, 0 }, { 218, 0 }, { 217, 0 },
+    { 219, 0 }, { 0, 56 }, { 2, 0 }, { 1, -1 },
+    { 0, -2 }, { 0, -79 }, { -97, 0 }, { -56, 0 },
+    { -130, 0 }, { 10795, 0 }, { -163, 0 }, { 10792, 0 },
+    { 0, 10815 }, { -195, 0 }, { 69, 0 }, { 71, 0 },
+    { 0, 10783 }, { 0, 10780 }, { 0, 10782 }, { 0, -210 },
+    { 0, -206 }, { 0, -205 }, { 0, -202 }, { 0, -203 },
+    { 0, 42319 }, { 0, 42315 }, { 0, -207 }, { 0, 42280 },
+    { 0, 42308 }, { 0, -209 }, { 0, -211 }, { 0, 10743 },
+    { 0, 42305 }, { 0, 10749 }, { 0, -213 }, { 0, -214 },
+    { 0, 10727 }, { 0, -218 }, { 0, 42307 }, { 0, 42282 },
+    { 0, -69 }, { 0, -217 }, { 0, -71 }, { 0, -219 },
+    { 0, 42261 }, { 0, 42258 }, { 0, 84 }, { 116, 0 },
+    { 38, 0 }, { 37, 0 }, { 64, 0 }, { 63, 0 },
+    { 0, -38 }, { 0, -37 }, { 0, -31 }, { 0, -64 },
+    { 0, -63 }, { 8, 0 }, { 0, -62 }, { 0, -57 },
+    { 0, -47 }, { 0, -54 }, { 0, -8 }, { 0, -86 },
+    { 0, -80 }, { 0, 7 }, { 0, -116 }, { -60, 0 },
+    { 0, -96 }, { -7, 0 }, { 80, 0 }, { 15, 0 },
+    { 0, -15 }, { 48, 0 }, { 0, -48 }, { 7264, 0 },
+    { 0, 3008 }, { 38864, 0 }, { 0, -6254 }, { 0, -6253 },
+    { 0, -6244 }, { 0, -6242 }, { 0, -6243 }, { 0, -6236 },
+    { 0, -6181 }, { 0, 35266 }, { -3008, 0 }, { 0, 35332 },
+    { 0, 3814 }, { 0, 35384 }, { 0, -59 }, { -7615, 0 },
+    { 0, 8 }, { -8, 0 }, { 0, 74 }, { 0, 86 },
+    { 0, 100 }, { 0, 128 }, { 0, 112 }, { 0, 126 },
+    { 0, 9 }, { -74, 0 }, { -9, 0 }, { 0, -7205 },
+    { -86, 0 }, { -100, 0 }, { -112, 0 }, { -128, 0 },
+    { -126, 0 }, { -7517, 0 }, { -8383, 0 }, { -8262, 0 },
+    { 28, 0 }, { 0, -28 }, { 16, 0 }, { 0, -16 },
+    { 26, 0 }, { 0, -26 }, { -10743, 0 }, { -3814, 0 },
+    { -10727, 0 }, { 0, -10795 }, { 0, -10792 }, { -10780, 0 },
+    { -10749, 0 }, { -10783, 0 }, { -10782, 0 }, { -10815, 0 },
+    { 0, -7264 }, { -35332, 0 }, { -42280, 0 }, { 0, 48 },
+    { -42308, 0 }, { -42319, 0 }, { -42315, 0 }, { -42305, 0 },
+    { -42258, 0 }, { -42282, 0 }, { -42261, 0 }, { 928, 0 },
+    { -48, 0 }, { -42307, 0 }, { -35384, 0 }, { 0, -928 },
+    { 0, -38864 }, { 40, 0 }, { 0, -40 }, { 39, 0 },
+    { 0, -39 }, { 34, 0 }, { 0, -34 },
+};
+
+// Internal: simple lowercase (upper = 0) or uppercase (upper = 1) mapping of a code point.
+static inline uint32_t zstr__case_map(uint32_t cp, int upper)
+{
+    if (cp >= ZSTR__CASE_LIMIT) return cp;
+    unsigned k = zstr__case_stage2[((unsigned)zstr__case_stage1[cp >> 6] << 6) | (cp & 63)];
+    return (uint32_t)((int32_t)cp + zstr__case_delta[k][upper]);
+}
+
+// Internal: SWAR ASCII case mapping of src[i..len) into dst, 8 bytes per step.
+// Stops at the first word with a high-bit byte and returns its offset.
+static inline size_t zstr__case_ascii_swar(const unsigned char *src, unsigned char *dst, size_t len,
+                                           size_t i, int upper)
+{
+    // Adding (0x80 - first) sets bit 7 of the bytes >= first, adding (0x7F - last)
+    // that of the bytes > last. All bytes are < 0x80, so nothing carries across.
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t ge = ones * (uint64_t)(0x80 - (upper ? 'a' : 'A'));
+    const uint64_t gt = ones * (uint64_t)(0x7F - (upper ? 'z' : 'Z'));
+    for (; i + 8 <= len; i += 8)
+    {
+        uint64_t w;
+        memcpy(&w, src + i, 8);
+        if (w & 0x8080808080808080ULL) break;
+        uint64_t letters = (w + ge) & ~(w + gt) & 0x8080808080808080ULL;
+        w ^= letters >> 2;
+        memcpy(dst + i, &w, 8);
+    }
+    return i;
+}
+
+#if defined(ZSTR_HAS_SSE2)
+// SSE2 ASCII case mapping: the letter range is moved to the bottom of the signed
+// byte range, so one compare finds it and bit 5 is flipped there.
+static inline size_t zstr__case_ascii_sse2(const unsigned char *src, unsigned char *dst, size_t len,
+                                           size_t i, int upper)
+{
+    const __m128i shift = _mm_set1_epi8((char)(0x80 - (upper ? 'a' : 'A')));
+    const __m128i limit = _mm_set1_epi8((char)(-128 + 26));
+    const __m128i flip = _mm_set1_epi8(0x20);
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+        if (_mm_movemask_epi8(v)) break;
+        __m128i letters = _mm_cmpgt_epi8(limit, _mm_add_epi8(v, shift));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(v, _mm_and_si128(letters, flip)));
+    }
+    return i;
+}
+#endif
+
+#if defined(ZSTR_HAS_AVX2)
+// AVX2 ASCII case mapping: same as the SSE2 one with 32 bytes per step.
+ZSTR_TARGET_AVX2
+static inline size_t zstr__case_ascii_avx2(const unsigned char *src, unsigned char *dst, size_t len,
+                                           size_t i, int upper)
+{
+    const __m256i shift = _mm256_set1_epi8((char)(0x80 - (upper ? 'a' : 'A')));
+    const __m256i limit = _mm256_set1_epi8((char)(-128 + 26));
+    const __m256i flip = _mm256_set1_epi8(0x20);
+    for (; i + 32 <= len; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + i));
+        if (_mm256_movemask_epi8(v)) break;
+        __m256i letters = _mm256_cmpgt_epi8(limit, _mm256_add_epi8(v, shift));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(v, _mm256_and_si256(letters, flip)));
+    }
+    return i;
+}
+#endif
+
+// Internal: maps the leading all-ASCII blocks of src[i..len) into dst. Returns the
+// offset of the first block with a high-bit byte, or of the tail shorter than a block.
+static inline size_t zstr__case_ascii(const unsigned char *src, unsigned char *dst, size_t len,
+                                      size_t i, int upper)
+{
+#if defined(ZSTR_HAS_AVX2)
+    if (len - i >= 32 && zstr__cpu_has_avx2()) i = zstr__case_ascii_avx2(src, dst, len, i, upper);
+#endif
+#if defined(ZSTR_HAS_SSE2)
+    return zstr__case_ascii_sse2(src, dst, len, i, upper);
+#else
+    return zstr__case_ascii_swar(src, dst, len, i, upper);
+#endif
+}
+
+// Internal: case-maps src[0..len) into dst while each mapping keeps its UTF-8
+// length. Returns the offset of the first character whose mapping does not, or
+// len. Only the 16-byte windows with high-bit bytes decode code points; invalid
+// bytes are copied as they are. dst may be src or start before it.
+static inline size_t zstr__case_span(const unsigned char *src, unsigned char *dst, size_t len, int upper)
+{
+    const unsigned first = upper ? 'a' : 'A';
+    size_t i = 0;
+    while (i < len)
+    {
+        i = zstr__case_ascii(src, dst, len, i, upper);
+        size_t stop = (len - i < 16) ? len : i + 16;
+        while (i < stop)
+        {
+            unsigned char c = src[i];
+            if (c < 0x80)
+            {
+                dst[i++] = (unsigned char)(c ^ (((unsigned)c - first < 26) << 5));
+                continue;
+            }
+
+            uint32_t cp = 0;
+            size_t n = zstr__utf8_decode(src, len, i, &cp);
+            if (n == 0)
+            {
+                dst[i++] = c;
+                continue;
+            }
+            uint32_t m = zstr__case_map(cp, upper);
+            if (zstr__utf8_width(m) != n) return i;
+            zstr__utf8_encode((char *)dst + i, m);
+            i += n;
+        }
+    }
+    return i;
+}
+
+// Internal: case-maps src[0..len) into dst, which has room for cap >= len bytes
+// and may be src or start before it. Mappings that change the length are written
+// while the rest still fits. Returns the bytes consumed; *written gets the bytes
+// produced.
+static inline size_t zstr__case_run(const unsigned char *src, size_t len, unsigned char *dst,
+                                    size_t cap, size_t *written, int upper)
+{
+    size_t i = 0, o = 0;
+    while (i < len)
+    {
+        size_t k = zstr__case_span(src + i, dst + o, len - i, upper);
+        i += k;
+        o += k;
+        if (i == len) break;
+
+        uint32_t cp = 0;
+        size_t n = zstr__utf8_decode(src, len, i, &cp);
+        uint32_t m = zstr__case_map(cp, upper);
+        if (o + zstr__utf8_width(m) + (len - i - n) > cap) break;
+        o += zstr__utf8_encode((char *)dst + o, m);
+        i += n;
+    }
+    *written = o;
+    return i;
+}
+
+// Internal: in-place case mapping. Same-length mappings overwrite the source.
+// From the first length change on, the rest is sized, shifted right by the
+// largest growth of any of its prefixes and mapped forward, so the write
+// cursor never passes the read cursor.
+static inline int zstr__case_inplace(zstr *s, int upper)
+{
+    size_t len = zstr_len(s);
+    unsigned char *p = (unsigned char *)zstr_data(s);
+    size_t i = zstr__case_span(p, p, len, upper);
+    if (i == len) return Z_OK;
+
+    // ASCII never changes length, so only the other characters are sized.
+    ptrdiff_t grow = 0, peak = 0;
+    size_t k = i;
+    while (k < len)
+    {
+        if (len - k >= 16 && zstr__ascii16(p + k))
+        {
+            k += 16;
+            continue;
+        }
+        uint32_t cp = 0;
+        size_t n = (p[k] < 0x80) ? 0 : zstr__utf8_decode(p, len, k, &cp);
+        if (n == 0)
+        {
+            k++;
+            continue;
+        }
+        grow += (ptrdiff_t)zstr__utf8_width(zstr__case_map(cp, upper)) - (ptrdiff_t)n;
+        if (grow > peak) peak = grow;
+        k += n;
+    }
+
+    size_t shift = (size_t)peak;
+    if (shift > 0)
+    {
+        if (shift > SIZE_MAX - 1 - len || zstr_reserve(s, len + shift) != Z_OK) return Z_ENOMEM;
+        p = (unsigned char *)zstr_data(s);
+        memmove(p + i + shift, p + i, len - i);
+    }
+
+    size_t o;
+    zstr__case_run(p + i + shift, len - i, p + i, len - i + shift, &o, upper);
+    p[i + o] = '\0';
+    zstr__set_len(s, i + o);
+    return Z_OK;
+}
+
+// Internal: appends the case mapping of src[0..len), which must not point into s.
+// Reserves len bytes once and grows only when a longer mapping does not fit.
+static inline int zstr__case_append(zstr *s, const char *src, size_t len, int upper)
+{
+    size_t base = zstr_len(s);
+    size_t room = base + len;
+    if (len > SIZE_MAX - 1 - base || zstr_reserve(s, room) != Z_OK) return Z_ENOMEM;
+
+    const unsigned char *in = (const unsigned char *)src;
+    size_t i = 0, o = base;
+    for (;;)
+    {
+        size_t w;
+        i += zstr__case_run(in + i, len - i, (unsigned char *)zstr_data(s) + o, room - o, &w, upper);
+        o += w;
+        if (i == len) break;
+
+        // A mapping adds at most one byte, so +4 covers the character and the rest.
+        // The length is set first so that a move off SSO keeps the mapped prefix.
+        size_t need = o + 4 + (len - i);
+        room = Z_GROWTH_FACTOR(room);
+        if (room < need) room = need;
+        zstr__set_len(s, o);
+        if (zstr_reserve(s, room) != Z_OK)
+        {
+            zstr_data(s)[base] = '\0';
+            zstr__set_len(s, base);
+            return Z_ENOMEM;
+        }
+    }
+
+    zstr_data(s)[o] = '\0';
+    zstr__set_len(s, o);
+    return Z_OK;
+}
+
+// Internal: replaces dst with the case mapping of src. A view into dst itself is
+// moved to the front and converted in place.
+static inline int zstr__case_into(zstr *dst, zstr_view src, int upper)
+{
+    const char *d = zstr_cstr(dst);
+    if (src.len == 0)
+    {
+        zstr_clear(dst);
+        return Z_OK;
+    }
+    if (src.data >= d && src.data <= d + zstr_len(dst))
+    {
+        char *p = zstr_data(dst);
+        memmove(p, src.data, src.len);
+        p[src.len] = '\0';
+        zstr__set_len(dst, src.len);
+        return zstr__case_inplace(dst, upper);
+    }
+    zstr_clear(dst);
+    return zstr__case_append(dst, src.data, src.len, upper);
+}
+
+// Converts the string to lowercase in-place. ASCII blocks are mapped with SIMD;
+// the other characters use the Unicode simple case mappings (invalid UTF-8 bytes
+// are left alone). A few mappings change the UTF-8 length (U+0130 -> 'i',
+// U+2C6F -> U+0250); Z_ENOMEM if the string had to grow and could not, in which
+// case only a prefix is converted.
+static inline int zstr_to_lower(zstr *s)
+{
+    return zstr__case_inplace(s, 0);
+}
+
+// Converts the string to uppercase in-place (see zstr_to_lower).
+static inline int zstr_to_upper(zstr *s)
+{
+    return zstr__case_inplace(s, 1);
+}
+
+// Replaces the contents of dst with the lowercase mapping of src, in the same
+// pass as the copy. src may be a view of dst. Returns Z_OK or Z_ENOMEM.
+static inline int zstr_to_lower_into(zstr *dst, zstr_view src)
+{
+    return zstr__case_into(dst, src, 0);
+}
+
+// Replaces the contents of dst with the uppercase mapping of src (see zstr_to_lower_into).
+static inline int zstr_to_upper_into(zstr *dst, zstr_view src)
+{
+    return zstr__case_into(dst, src, 1);
+}
+
+
+/* Views and Slices (Zero-Copy) */
+
+// Helper macro to create a view from a string literal.
+#define ZSV(lit) (zstr_view){ .data = (lit), .len = sizeof(lit) -1 }
+
+// Creates a view from a C-string.
+static inline zstr_view zstr_view_from(const char *cstr)
+{
+    return (zstr_view){ .data = cstr, .len = strlen(cstr) };
+}
+
+// Creates a view covering the entire zstr.
+static inline zstr_view zstr_as_view(const zstr *s)
+{
+    return (zstr_view){ .data = zstr_cstr(s), .len = zstr_len(s) };
+}
+
+// Converts a view back into an owning zstr (allocates).
+static inline zstr zstr_from_view(zstr_view v) 
+{
+    return zstr_from_len(v.data, v.len);
+}
+
+// Returns a substring view.
+static inline zstr_view zstr_sub(zstr_view v, size_t start, size_t len)
+{
+    if (start >= v.len) return (zstr_view){ "", 0 };
+    if (start + len > v.len) len = v.len - start;
+    return (zstr_view){ .data = v.data + start, .len = len };
+}
+
+// Checks if view equals a C-string.
+static inline bool zstr_view_eq(zstr_view v, const char *cstr)
+{
+    if (strlen(cstr) != v.len) return false;
+    return memcmp(v.data, cstr, v.len) == 0;
+}
+
+// Checks if two views are equal.
+static inline bool zstr_view_eq_view(zstr_view a, zstr_view b) 
+{
+    if (a.len != b.len) return false;
+    return memcmp(a.data, b.data, a.len) == 0;
+}
+
+// Checks if view starts with prefix.
+static inline bool zstr_view_starts_with(zstr_view v, const char *prefix) 
+{
+    size_t pre_len = strlen(prefix);
+    if (pre_len > v.len) return false;
+    return memcmp(v.data, prefix, pre_len) == 0;
+}
+
+// Checks if view ends with suffix.
+static inline bool zstr_view_ends_with(zstr_view v, const char *suffix) 
+{
+    size_t suf_len = strlen(suffix);
+    if (suf_len > v.len) return false;
+    return memcmp(v.data + v.len - suf_len, suffix, suf_len) == 0;
+}
+
+// Wrapper for checking if an owning zstr starts with prefix.
+static inline bool zstr_starts_with(const zstr *s, const char *prefix) 
+{
+    return zstr_view_starts_with(zstr_as_view(s), prefix);
+}
+
+// Wrapper for checking if an owning zstr ends with suffix.
+static inline bool zstr_ends_with(const zstr *s, const char *suffix) 
+{
+    return zstr_view_ends_with(zstr_as_view(s), suffix);
+}
+
+
+// Trims whitespace from the start of the view.
+static inline zstr_view zstr_view_lstrip(zstr_view v) 
+{
+    const char *start = v.data;
+    const char *end = v.data + v.len;
+    while (start < end && isspace((unsigned char)*start)) start++;
+    return (zstr_view){ .data = start, .len = (size_t)(end - start) };
+}
+
+// Trims whitespace from the end of the view.
+static inline zstr_view zstr_view_rstrip(zstr_view v) 
+{
+    const char *start = v.data;
+    const char *end = v.data + v.len;
+    while (end > start && isspace((unsigned char)*(end - 1))) end--;
+    return (zstr_view){ .data = start, .len = (size_t)(end - start) };
+}
+
+// Trims whitespace from both ends.
+static inline zstr_view zstr_view_trim(zstr_view v) 
+{
+    return zstr_view_lstrip(zstr_view_rstrip(v));
+}
+
+// Converts a view to an integer (simple atoi replacement).
+// Returns true if successful, false if empty or invalid chars found.
+static inline bool zstr_view_to_int(zstr_view v, int *out)
+{
+    if (v.len == 0) return false;
+    
+    int sign = 1;
+    size_t i = 0;
+    
+    if (v.data[0] == '-') 
+    { 
+        sign = -1; 
+        i++; 
+    }
+    else if (v.data[0] == '+')
+    {
+        i++;
+    }
+    
+    if (i == v.len) return false;
+
+    int result = 0;
+    for (; i < v.len; i++) 
+    {
+        if (v.data[i] < '0' || v.data[i] > '9') return false; 
+        result = result * 10 + (v.data[i] - '0');
+    }
+    
+    *out = result * sign;
+    return true;
+}
+
+// Initializes an iterator for splitting a view by a delimiter view (may contain NULs).
+static inline zstr_split_iter zstr_split_init_view(zstr_view src, zstr_view delim)
+{
+    zstr_split_iter it;
+    it.source = src;
+    it.delim = delim;
+    it.current_pos = 0;
+    it.finished = false;
+    return it;
+}
+
+// Initializes an iterator for splitting a string.
+static inline zstr_split_iter zstr_split_init(zstr_view src, const char *delim) 
+{
+    return zstr_split_init_view(src, zstr_view_from(delim));
+}
+
+// Gets the next part in a split iteration. Returns false when done.
+// Single-byte delimiters are located with memchr, longer ones with the
+// SIMD first/last byte filter. An empty delimiter yields the whole source.
+static inline bool zstr_split_next(zstr_split_iter *it, zstr_view *out_part) 
+{
+    if (it->finished) return false;
+
+    const char *start = it->source.data + it->current_pos;
+    size_t remaining = it->source.len - it->current_pos;
+    const char *found = NULL;
+
+    if (it->delim.len == 1 && remaining > 0)
+    {
+        found = (const char *)memchr(start, it->delim.data[0], remaining);
+    }
+    else if (it->delim.len > 1)
+    {
+        found = zstr__memmem(start, remaining, it->delim.data, it->delim.len);
+    }
+
+    if (!found) 
+    {
+        out_part->data = start;
+        out_part->len = remaining;
+        it->finished = true;
+    }
+    else 
+    {
+        size_t found_at = (size_t)(found - start);
+        out_part->data = start;
+        out_part->len = found_at;
+        it->current_pos += found_at + it->delim.len;
+    }
+    
+    return true;
+}
+
+
+// Splits `src` into out[0..cap) in one pass. Returns the total number of fields,
+// which may exceed `cap` (only the first `cap` are written). Fields match the
+// views produced by zstr_split_next.
+static inline size_t zstr_split_into(zstr_view src, zstr_view delim, zstr_view *out, size_t cap)
+{
+    if (delim.len == 1) return zstr__split_byte(src.data, src.len, delim.data[0], out, cap);
+
+    size_t count = 0, start = 0;
+    if (delim.len > 1)
+    {
+        const char *hit;
+        while ((hit = zstr__memmem(src.data + start, src.len - start, delim.data, delim.len)) != NULL)
+        {
+            size_t pos = (size_t)(hit - src.data);
+            zstr__emit_field(out, cap, &count, src.data, start, pos);
+            start = pos + delim.len;
+        }
+    }
+    zstr__emit_field(out, cap, &count, src.data, start, src.len);
+    return count;
+}
+
+// Returns the number of fields zstr_split_into would produce.
+static inline size_t zstr_split_count(zstr_view src, zstr_view delim)
+{
+    if (delim.len == 1) return zstr__count_byte(src.data, src.len, delim.data[0]) + 1;
+    return zstr_split_into(src, delim, NULL, 0);
+}
+
+// Releases the storage of a view array.
+static inline void zstr_view_array_free(zstr_view_array *arr)
+{
+    Z_FREE(arr->items);
+    arr->items = NULL;
+    arr->count = 0;
+    arr->cap = 0;
+}
+
+// Splits `src` into `arr`, replacing its contents and growing it as needed.
+// Reuse the same array across lines to avoid reallocations. Returns Z_OK or Z_ENOMEM.
+static inline int zstr_split_all(zstr_view src, zstr_view delim, zstr_view_array *arr)
+{
+    size_t n = zstr_split_into(src, delim, arr->items, arr->cap);
+    if (n > arr->cap)
+    {
+        size_t new_cap = arr->cap;
+        while (new_cap < n) new_cap = Z_GROWTH_FACTOR(new_cap);
+
+        zstr_view *items = (zstr_view *)Z_REALLOC(arr->items, new_cap * sizeof(zstr_view));
+        if (!items) return Z_ENOMEM;
+        arr->items = items;
+        arr->cap = new_cap;
+        zstr_split_into(src, delim, arr->items, arr->cap);
+    }
+    arr->count = n;
+    return Z_OK;
+}
+
+
+/* Multi-Pattern Matching (Aho-Corasick) */
+
+#define ZSTR__AC_NONE UINT32_MAX
+
+// Pattern sets with at most this many automaton states use the dense DFA.
+#ifndef ZSTR_MATCHER_DENSE_MAX
+    #define ZSTR_MATCHER_DENSE_MAX 1024
+#endif
+
+// Internal: trie edge lookup in the build-time linked lists.
+static inline uint32_t zstr__ac_edge(const uint32_t *first, const uint8_t *ebyte, const uint32_t *enext,
+                                     const uint32_t *esib, uint32_t s, uint8_t c)
+{
+    for (uint32_t e = first[s]; e != ZSTR__AC_NONE; e = esib[e])
+    {
+        if (ebyte[e] == c) return enext[e];
+    }
+    return ZSTR__AC_NONE;
+}
+
+// Releases all memory held by the matcher.
+static inline void zstr_matcher_free(zstr_matcher *m)
+{
+    Z_FREE(m->delta);
+    Z_FREE(m->root);
+    Z_FREE(m->trans_off);
+    Z_FREE(m->trans_byte);
+    Z_FREE(m->trans_next);
+    Z_FREE(m->fail);
+    Z_FREE(m->out);
+    Z_FREE(m->out_link);
+    Z_FREE(m->dup_next);
+    Z_FREE(m->pat_len);
+    memset(m, 0, sizeof(*m));
+}
+
+// Builds a matcher from `count` patterns. Empty patterns never match.
+// The patterns are not referenced after this call. Returns Z_OK, Z_EINVAL when the
+// pattern count or total pattern size exceeds the automaton limits, or Z_ENOMEM.
+static inline int zstr_matcher_init(zstr_matcher *m, const zstr_view *patterns, size_t count)
+{
+    memset(m, 0, sizeof(*m));
+
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) total += patterns[i].len;
+    if (count >= ZSTR__AC_NONE || total >= ZSTR__AC_NONE) return Z_EINVAL;
+
+    const size_t max_states = total + 1;
+    uint32_t states = 1, edges = 0;
+    size_t head = 0, tail = 0;
+
+    // Build-time trie: edges kept as per-state linked lists.
+    uint32_t *first = (uint32_t *)Z_MALLOC(max_states * sizeof(uint32_t));
+    uint8_t  *ebyte = (uint8_t *)Z_MALLOC(total + 1);
+    uint32_t *enext = (uint32_t *)Z_MALLOC((total + 1) * sizeof(uint32_t));
+    uint32_t *esib  = (uint32_t *)Z_MALLOC((total + 1) * sizeof(uint32_t));
+    uint32_t *queue = (uint32_t *)Z_MALLOC(max_states * sizeof(uint32_t));
+
+    m->fail     = (uint32_t *)Z_MALLOC(max_states * sizeof(uint32_t));
+    m->out      = (uint32_t *)Z_MALLOC(max_states * sizeof(uint32_t));
+    m->out_link = (uint32_t *)Z_MALLOC(max_states * sizeof(uint32_t));
+    m->dup_next = (uint32_t *)Z_MALLOC((count + 1) * sizeof(uint32_t));
+    m->pat_len  = (size_t *)Z_MALLOC((count + 1) * sizeof(size_t));
+
+    int rc = Z_ENOMEM;
+    if (!first || !ebyte || !enext || !esib || !queue ||
+        !m->fail || !m->out || !m->out_link || !m->dup_next || !m->pat_len) goto done;
+
+    first[0] = ZSTR__AC_NONE;
+    m->out[0] = ZSTR__AC_NONE;
+
+    for (size_t id = 0; id < count; id++)
+    {
+        const uint8_t *p = (const uint8_t *)patterns[id].data;
+        uint32_t s = 0;
+
+        m->pat_len[id] = patterns[id].len;
+        m->dup_next[id] = ZSTR__AC_NONE;
+        if (patterns[id].len == 0) continue;
+
+        for (size_t i = 0; i < patterns[id].len; i++)
+        {
+            uint32_t next = zstr__ac_edge(first, ebyte, enext, esib, s, p[i]);
+            if (next == ZSTR__AC_NONE)
+            {
+                next = states++;
+                first[next] = ZSTR__AC_NONE;
+                m->out[next] = ZSTR__AC_NONE;
+
+                ebyte[edges] = p[i];
+                enext[edges] = next;
+                esib[edges] = first[s];
+                first[s] = edges++;
+            }
+            s = next;
+        }
+        m->dup_next[id] = m->out[s];
+        m->out[s] = (uint32_t)id;
+    }
+
+    m->state_count = states;
+    m->pattern_count = count;
+
+    // Breadth-first pass: failure and output links (parents before children).
+    m->fail[0] = 0;
+    m->out_link[0] = ZSTR__AC_NONE;
+    queue[tail++] = 0;
+
+    while (head < tail)
+    {
+        uint32_t r = queue[head++];
+        for (uint32_t e = first[r]; e != ZSTR__AC_NONE; e = esib[e])
+        {
+            uint32_t u = enext[e];
+            uint32_t f = 0;
+
+            if (r != 0)
+            {
+                uint32_t g = m->fail[r];
+                for (;;)
+                {
+                    f = zstr__ac_edge(first, ebyte, enext, esib, g, ebyte[e]);
+                    if (f != ZSTR__AC_NONE || g == 0) break;
+                    g = m->fail[g];
+                }
+                if (f == ZSTR__AC_NONE) f = 0;
+            }
+
+            m->fail[u] = f;
+            m->out_link[u] = (m->out[f] != ZSTR__AC_NONE) ? f : m->out_link[f];
+            queue[tail++] = u;
+        }
+    }
+
+    if (states <= ZSTR_MATCHER_DENSE_MAX)
+    {
+        // Dense DFA: inherit the failure state's row, then overlay own edges.
+        m->delta = (uint32_t *)Z_MALLOC((size_t)states * 256 * sizeof(uint32_t));
+        if (!m->delta) goto done;
+
+        for (size_t q = 0; q < tail; q++)
+        {
+            uint32_t s = queue[q];
+            uint32_t *row = m->delta + (size_t)s * 256;
+
+            if (s == 0) memset(row, 0, 256 * sizeof(uint32_t));
+            else memcpy(row, m->delta + (size_t)m->fail[s] * 256, 256 * sizeof(uint32_t));
+
+            for (uint32_t e = first[s]; e != ZSTR__AC_NONE; e = esib[e]) row[ebyte[e]] = enext[e];
+        }
+    }
+    else
+    {
+        // Compact NFA: transitions flattened per state and sorted by byte.
+        m->root       = (uint32_t *)Z_CALLOC(256, sizeof(uint32_t));
+        m->trans_off  = (uint32_t *)Z_MALLOC(((size_t)states + 1) * sizeof(uint32_t));
+        m->trans_byte = (uint8_t *)Z_MALLOC(edges + 1);
+        m->trans_next = (uint32_t *)Z_MALLOC(((size_t)edges + 1) * sizeof(uint32_t));
+        if (!m->root || !m->trans_off || !m->trans_byte || !m->trans_next) goto done;
+
+        uint32_t k = 0;
+        for (uint32_t s = 0; s < states; s++)
+        {
+            m->trans_off[s] = k;
+            for (uint32_t e = first[s]; e != ZSTR__AC_NONE; e = esib[e])
+            {
+                // Insertion sort: most states have only a handful of edges.
+                uint32_t j = k++;
+                while (j > m->trans_off[s] && m->trans_byte[j - 1] > ebyte[e])
+                {
+                    m->trans_byte[j] = m->trans_byte[j - 1];
+                    m->trans_next[j] = m->trans_next[j - 1];
+                    j--;
+                }
+                m->trans_byte[j] = ebyte[e];
+                m->trans_next[j] = enext[e];
+            }
+            if (s == 0)
+            {
+                for (uint32_t e = first[0]; e != ZSTR__AC_NONE; e = esib[e]) m->root[ebyte[e]] = enext[e];
+            }
+        }
+        m->trans_off[states] = k;
+    }
+
+    rc = Z_OK;
+
+done:
+    Z_FREE(first);
+    Z_FREE(ebyte);
+    Z_FREE(enext);
+    Z_FREE(esib);
+    Z_FREE(queue);
+    if (rc != Z_OK) zstr_matcher_free(m);
+    return rc;
+}
+
+// Internal: one automaton transition.
+static inline uint32_t zstr__matcher_step(const zstr_matcher *m, uint32_t s, uint8_t c)
+{
+    if (m->delta) return m->delta[(size_t)s * 256 + c];
+
+    while (s != 0)
+    {
+        for (uint32_t e = m->trans_off[s]; e < m->trans_off[s + 1]; e++)
+        {
+            if (m->trans_byte[e] == c) return m->trans_next[e];
+            if (m->trans_byte[e] > c) break;
+        }
+        s = m->fail[s];
+    }
+    return m->root[c];
+}
+
+// Initializes a single-pass scan of `src`.
+static inline zstr_matcher_iter zstr_matcher_iter_init(const zstr_matcher *m, zstr_view src)
+{
+    zstr_matcher_iter it;
+    it.m = m;
+    it.source = src;
+    it.pos = 0;
+    it.state = 0;
+    it.pending_state = ZSTR__AC_NONE;
+    it.pending_pat = ZSTR__AC_NONE;
+    return it;
+}
+
+// Reports the next match (ordered by end offset, overlaps included). Returns false when done.
+static inline bool zstr_matcher_next(zstr_matcher_iter *it, zstr_match *out)
+{
+    const zstr_matcher *m = it->m;
+
+    for (;;)
+    {
+        if (it->pending_pat != ZSTR__AC_NONE)
+        {
+            uint32_t id = it->pending_pat;
+            it->pending_pat = m->dup_next[id];
+            out->id = id;
+            out->len = m->pat_len[id];
+            out->start = it->pos - out->len;
+            return true;
+        }
+
+        if (it->pending_state != ZSTR__AC_NONE)
+        {
+            it->pending_pat = m->out[it->pending_state];
+            it->pending_state = m->out_link[it->pending_state];
+            continue;
+        }
+
+        if (it->pos >= it->source.len || !m->out) return false;
+
+        it->state = zstr__matcher_step(m, it->state, (uint8_t)it->source.data[it->pos++]);
+        it->pending_state = (m->out[it->state] != ZSTR__AC_NONE) ? it->state : m->out_link[it->state];
+    }
+}
+
+// Returns true if any pattern occurs in the view (stops at the first match).
+static inline bool zstr_matcher_contains(const zstr_matcher *m, zstr_view v)
+{
+    zstr_matcher_iter it = zstr_matcher_iter_init(m, v);
+    zstr_match match;
+    return zstr_matcher_next(&it, &match);
+}
+
+
+/* String Interning */
+
+// Internal: frees one shard.
+static inline void zstr__intern_shard_free(zstr_intern_shard *sh)
+{
+    Z_FREE(sh->slots);
+    Z_FREE(sh->entries);
+    zstr_arena_free(&sh->arena);
+    memset(sh, 0, sizeof(*sh));
+}
+
+// Creates a pool. `shards` = 0 gives a single unsynchronized table; any other
+// value makes the pool thread-safe with that many independently locked shards
+// (rounded up to a power of two). Returns Z_OK or Z_ENOMEM.
+static inline int zstr_intern_init(zstr_intern *p, size_t shards)
+{
+    memset(p, 0, sizeof(*p));
+    p->locked = shards > 0;
+
+    size_t n = 1;
+    while (n < shards && n < 256)
+    {
+        n <<= 1;
+        p->shard_bits++;
+    }
+
+    p->shards = (zstr_intern_shard *)Z_CALLOC(n, sizeof(zstr_intern_shard));
+    if (!p->shards) return Z_ENOMEM;
+
+    p->shard_count = (uint32_t)n;
+    for (size_t i = 0; i < n; i++) p->shards[i].arena = zstr_arena_init(0);
+    return Z_OK;
+}
+
+// Releases the pool. Every interned view becomes invalid.
+static inline void zstr_intern_free(zstr_intern *p)
+{
+    for (uint32_t i = 0; i < p->shard_count; i++) zstr__intern_shard_free(&p->shards[i]);
+    Z_FREE(p->shards);
+    memset(p, 0, sizeof(*p));
+}
+
+// Internal: locks a shard in thread-safe pools.
+static inline void zstr__intern_lock(const zstr_intern *p, zstr_intern_shard *sh)
+{
+    if (p->locked) ZSTR__SPIN_LOCK(&sh->lock);
+}
+
+// Internal: unlocks a shard in thread-safe pools.
+static inline void zstr__intern_unlock(const zstr_intern *p, zstr_intern_shard *sh)
+{
+    if (p->locked) ZSTR__SPIN_UNLOCK(&sh->lock);
+}
+
+// Internal: doubles the slot array of a shard. Slots are placed by their hash tag,
+// so entries move without being rehashed.
+static inline int zstr__intern_grow(zstr_intern_shard *sh)
+{
+    size_t cap = sh->slot_cap ? sh->slot_cap * 2 : 64;
+    uint64_t *slots = (uint64_t *)Z_CALLOC(cap, sizeof(uint64_t));
+    if (!slots) return Z_ENOMEM;
+
+    for (size_t i = 0; i < sh->slot_cap; i++)
+    {
+        uint64_t slot = sh->slots[i];
+        if (!slot) continue;
+
+        size_t pos = (size_t)(slot >> 32) & (cap - 1);
+        while (slots[pos]) pos = (pos + 1) & (cap - 1);
+        slots[pos] = slot;
+    }
+
+    Z_FREE(sh->slots);
+    sh->slots = slots;
+    sh->slot_cap = cap;
+    return Z_OK;
+}
+
+// Internal: finds or inserts `v` (with precomputed hash `h`) in its shard. The low
+// hash bits pick the shard, the high 32 bits are the slot tag and probe start.
+// The caller holds the shard lock. Returns the local index + 1, or 0 on failure.
+static inline uint32_t zstr__intern_shard_put(zstr_intern_shard *sh, unsigned shard_bits,
+                                              zstr_view v, uint64_t h, bool insert)
+{
+    uint64_t tag = h & 0xFFFFFFFF00000000ULL;
+
+    if (sh->slot_cap)
+    {
+        size_t mask = sh->slot_cap - 1;
+        size_t pos = (size_t)(h >> 32) & mask;
+        for (;;)
+        {
+            uint64_t slot = sh->slots[pos];
+            if (!slot) break;
+
+            if ((slot & 0xFFFFFFFF00000000ULL) == tag)
+            {
+                const zstr_view *e = &sh->entries[(uint32_t)slot - 1];
+                if (e->len == v.len && memcmp(e->data, v.data, v.len) == 0) return (uint32_t)slot;
+            }
+            pos = (pos + 1) & mask;
+        }
+    }
+
+    if (!insert) return 0;
+    if (sh->count >= (UINT32_MAX >> shard_bits) - 1) return 0;
+
+    // Keep the load factor under 3/4.
+    if ((sh->count + 1) * 4 > sh->slot_cap * 3)
+    {
+        if (zstr__intern_grow(sh) != Z_OK) return 0;
+    }
+
+    if (sh->count == sh->entries_cap)
+    {
+        size_t new_cap = sh->entries_cap ? sh->entries_cap * 2 : 32;
+        zstr_view *entries = (zstr_view *)Z_REALLOC(sh->entries, new_cap * sizeof(zstr_view));
+        if (!entries) return 0;
+        sh->entries = entries;
+        sh->entries_cap = new_cap;
+    }
+
+    char *data = (char *)zstr_arena_alloc(&sh->arena, v.len + 1);
+    if (!data) return 0;
+    if (v.len) memcpy(data, v.data, v.len);
+    data[v.len] = '\0';
+
+    uint32_t local = (uint32_t)sh->count++;
+    sh->entries[local].data = data;
+    sh->entries[local].len = v.len;
+    sh->string_bytes += v.len;
+
+    size_t mask = sh->slot_cap - 1;
+    size_t pos = (size_t)(h >> 32) & mask;
+    while (sh->slots[pos]) pos = (pos + 1) & mask;
+    sh->slots[pos] = tag | (local + 1);
+
+    return local + 1;
+}
+
+// Internal: intern or look up with a precomputed hash.
+static inline zstr_interned zstr__intern_with_hash(zstr_intern *p, zstr_view v, uint64_t h, bool insert)
+{
+    zstr_interned out;
+    out.view.data = NULL;
+    out.view.len = 0;
+    out.id = 0;
+
+    if (!p->shards) return out;
+
+    uint32_t shard = (uint32_t)h & (p->shard_count - 1);
+    zstr_intern_shard *sh = &p->shards[shard];
+
+    zstr__intern_lock(p, sh);
+    uint32_t local = zstr__intern_shard_put(sh, p->shard_bits, v, h, insert);
+    if (local)
+    {
+        out.view = sh->entries[local - 1];
+        out.id = (local << p->shard_bits) | shard;
+    }
+    zstr__intern_unlock(p, sh);
+
+    return out;
+}
+
+// Interns a view: returns the canonical copy and its id. Equal strings always get
+// the same id and data pointer. id == 0 signals an allocation failure.
+static inline zstr_interned zstr_intern_view(zstr_intern *p, zstr_view v)
+{
+    return zstr__intern_with_hash(p, v, zstr__hash(v.data, v.len, 0), true);
+}
+
+// Interns a C-string.
+static inline zstr_interned zstr_intern_cstr(zstr_intern *p, const char *cstr)
+{
+    zstr_view v;
+    v.data = cstr;
+    v.len = strlen(cstr);
+    return zstr_intern_view(p, v);
+}
+
+// Looks a view up without inserting it. Returns id == 0 if it was never interned.
+static inline zstr_interned zstr_intern_find(zstr_intern *p, zstr_view v)
+{
+    return zstr__intern_with_hash(p, v, zstr__hash(v.data, v.len, 0), false);
+}
+
+// Interns `n` views into `out`. Hashes are computed up front so the table
+// probes of the second pass overlap better. Returns Z_OK or Z_ENOMEM.
+static inline int zstr_intern_bulk(zstr_intern *p, const zstr_view *in, size_t n, zstr_interned *out)
+{
+    uint64_t hashes[64];
+    int rc = Z_OK;
+
+    for (size_t base = 0; base < n; base += 64)
+    {
+        size_t chunk = n - base < 64 ? n - base : 64;
+        for (size_t i = 0; i < chunk; i++) hashes[i] = zstr__hash(in[base + i].data, in[base + i].len, 0);
+
+        for (size_t i = 0; i < chunk; i++)
+        {
+            out[base + i] = zstr__intern_with_hash(p, in[base + i], hashes[i], true);
+            if (!out[base + i].id) rc = Z_ENOMEM;
+        }
+    }
+    return rc;
+}
+
+// Returns the canonical view of an id (empty view for unknown ids).
+static inline zstr_view zstr_intern_get(zstr_intern *p, uint32_t id)
+{
+    zstr_view v;
+    v.data = NULL;
+    v.len = 0;
+
+    uint32_t shard = id & (p->shard_count - 1);
+    uint32_t local = id >> p->shard_bits;
+    if (!p->shards || !local) return v;
+
+    zstr_intern_shard *sh = &p->shards[shard];
+    zstr__intern_lock(p, sh);
+    if (local <= sh->count) v = sh->entries[local - 1];
+    zstr__intern_unlock(p, sh);
+    return v;
+}
+
+// Returns memory usage counters (summed over all shards).
+static inline zstr_intern_stats zstr_intern_stats_get(zstr_intern *p)
+{
+    zstr_intern_stats st;
+    memset(&st, 0, sizeof(st));
+
+    for (uint32_t i = 0; i < p->shard_count; i++)
+    {
+        zstr_intern_shard *sh = &p->shards[i];
+        zstr__intern_lock(p, sh);
+        st.count        += sh->count;
+        st.string_bytes += sh->string_bytes;
+        st.arena_bytes  += sh->arena.reserved;
+        st.table_bytes  += sh->slot_cap * sizeof(uint64_t) + sh->entries_cap * sizeof(zstr_view);
+        zstr__intern_unlock(p, sh);
+    }
+    st.table_bytes += p->shard_count * sizeof(zstr_intern_shard);
+    return st;
+}
+
+/* Ropes (Chunked Builders) */
+
+// First chunk capacity of a rope; later chunks double up to ZSTR_ROPE_MAX_CHUNK.
+#ifndef ZSTR_ROPE_MIN_CHUNK
+    #define ZSTR_ROPE_MIN_CHUNK 256
+#endif
+
+#ifndef ZSTR_ROPE_MAX_CHUNK
+    #define ZSTR_ROPE_MAX_CHUNK (1024 * 1024)
+#endif
+
+// Internal: allocation size of a chunk holding `cap` bytes.
+static inline size_t zstr__rope_block_size(size_t cap)
+{
+    return sizeof(zstr_rope_block) + cap;
+}
+
+// Internal: bytes of a chunk.
+static inline char* zstr__rope_block_data(zstr_rope_block *c)
+{
+    return (char *)(c + 1);
+}
+
+// Internal: drops one reference to a chunk (NULL = borrowed piece).
+static inline void zstr__rope_block_release(zstr_rope_block *c)
+{
+    if (c && ZSTR__ATOMIC_DEC(&c->refs) == 0)
+    {
+        zstr__mem_free(c->alloc, (char *)c, zstr__rope_block_size(c->cap));
+    }
+}
+
+// Internal: makes room for `extra` more pieces.
+static inline int zstr__rope_reserve(zstr_rope *r, size_t extra)
+{
+    if (r->cap - r->count >= extra) return Z_OK;
+
+    size_t new_cap = r->cap;
+    while (new_cap - r->count < extra) new_cap = Z_GROWTH_FACTOR(new_cap);
+
+    zstr_rope_piece *p = (zstr_rope_piece *)Z_REALLOC(r->pieces, new_cap * sizeof(zstr_rope_piece));
+    if (!p) return Z_ENOMEM;
+    r->pieces = p;
+    r->cap = new_cap;
+    return Z_OK;
+}
+
+// Internal: appends a piece (room must be reserved). Takes over one reference
+// to `chunk`; a piece that continues the previous one is merged into it.
+static inline void zstr__rope_push(zstr_rope *r, zstr_rope_block *chunk, const char *data, size_t len)
+{
+    r->len += len;
+    if (r->count)
+    {
+        zstr_rope_piece *last = &r->pieces[r->count - 1];
+        if (last->chunk == chunk && last->data + last->len == data)
+        {
+            last->len += len;
+            last->end = r->len;
+            zstr__rope_block_release(chunk);
+            return;
+        }
+    }
+
+    zstr_rope_piece *p = &r->pieces[r->count++];
+    p->chunk = chunk;
+    p->data = data;
+    p->len = len;
+    p->end = r->len;
+}
+
+// Internal: index of the piece holding byte `pos` (pos < r->len).
+static inline size_t zstr__rope_locate(const zstr_rope *r, size_t pos)
+{
+    size_t lo = 0, hi = r->count - 1;
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (r->pieces[mid].end > pos) hi = mid;
+        else lo = mid + 1;
+    }
+    return lo;
+}
+
+// Returns an empty rope (no allocation).
+static inline zstr_rope zstr_rope_init(void)
+{
+    zstr_rope r;
+    memset(&r, 0, sizeof(r));
+    r.next_chunk = ZSTR_ROPE_MIN_CHUNK;
+    return r;
+}
+
+// Releases every chunk reference but keeps the piece array for reuse.
+static inline void zstr_rope_clear(zstr_rope *r)
+{
+    for (size_t i = 0; i < r->count; i++) zstr__rope_block_release(r->pieces[i].chunk);
+    r->count = 0;
+    r->len = 0;
+    r->next_chunk = ZSTR_ROPE_MIN_CHUNK;
+}
+
+// Frees the rope. Chunks still referenced by other ropes stay alive.
+static inline void zstr_rope_free(zstr_rope *r)
+{
+    zstr_rope_clear(r);
+    Z_FREE(r->pieces);
+    r->pieces = NULL;
+    r->cap = 0;
+}
+
+// Returns the total length in bytes.
+static inline size_t zstr_rope_len(const zstr_rope *r)
+{
+    return r->len;
+}
+
+// Copies ptr + len onto the end of the rope. Bytes go into the tail chunk while
+// it has room, then into a new chunk (capacities double up to ZSTR_ROPE_MAX_CHUNK,
+// larger appends get a chunk of their own). Nothing already stored is moved or
+// reallocated. Returns Z_OK or Z_ENOMEM (the rope is unchanged on failure).
+static inline int zstr_rope_append_len(zstr_rope *r, const char *ptr, size_t len)
+{
+    if (len == 0) return Z_OK;
+
+    // The tail chunk can take more bytes if this rope is its only user and
+    // the last piece ends at its fill mark.
+    zstr_rope_block *tail = NULL;
+    size_t room = 0;
+    if (r->count)
+    {
+        zstr_rope_piece *last = &r->pieces[r->count - 1];
+        zstr_rope_block *c = last->chunk;
+        if (c && ZSTR__ATOMIC_LOAD(&c->refs) == 1 &&
+            last->data + last->len == zstr__rope_block_data(c) + c->used)
+        {
+            tail = c;
+            room = c->cap - c->used;
+        }
+    }
+
+    size_t head = len < room ? len : room;
+    size_t rest = len - head;
+    zstr_rope_block *fresh = NULL;
+
+    if (rest)
+    {
+        if (zstr__rope_reserve(r, 1) != Z_OK) return Z_ENOMEM;
+
+        size_t cap = rest > r->next_chunk ? rest : r->next_chunk;
+        uint8_t id = *zstr__allocator_scope();
+        fresh = (zstr_rope_block *)zstr__mem_alloc(id, zstr__rope_block_size(cap));
+        if (!fresh) return Z_ENOMEM;
+
+        fresh->refs = 1;
+        fresh->cap = cap;
+        fresh->used = 0;
+        fresh->alloc = id;
+        if (r->next_chunk < ZSTR_ROPE_MAX_CHUNK) r->next_chunk *= 2;
+    }
+
+    if (head)
+    {
+        char *dst = zstr__rope_block_data(tail) + tail->used;
+        memcpy(dst, ptr, head);
+        tail->used += head;
+        r->pieces[r->count - 1].len += head;
+        r->len += head;
+        r->pieces[r->count - 1].end = r->len;
+    }
+
+    if (fresh)
+    {
+        char *dst = zstr__rope_block_data(fresh);
+        memcpy(dst, ptr + head, rest);
+        fresh->used = rest;
+        zstr__rope_push(r, fresh, dst, rest);
+    }
+    return Z_OK;
+}
+
+// Copies a C-string onto the end of the rope.
+static inline int zstr_rope_append(zstr_rope *r, const char *cstr)
+{
+    return zstr_rope_append_len(r, cstr, strlen(cstr));
+}
+
+// Copies a view onto the end of the rope.
+static inline int zstr_rope_append_view(zstr_rope *r, zstr_view v)
+{
+    return zstr_rope_append_len(r, v.data, v.len);
+}
+
+// Copies the contents of a zstr onto the end of the rope.
+static inline int zstr_rope_append_zstr(zstr_rope *r, const zstr *s)
+{
+    return zstr_rope_append_len(r, zstr_cstr(s), zstr_len(s));
+}
+
+// Appends a view without copying it. The bytes are borrowed: they must stay
+// valid and unchanged for as long as this rope (or a slice of it) is used.
+static inline int zstr_rope_append_ref(zstr_rope *r, zstr_view v)
+{
+    if (v.len == 0) return Z_OK;
+    if (zstr__rope_reserve(r, 1) != Z_OK) return Z_ENOMEM;
+    zstr__rope_push(r, NULL, v.data, v.len);
+    return Z_OK;
+}
+
+// Appends the contents of `src` to `r` by sharing its chunks (no byte copies,
+// O(pieces of src)). `src` may be `r` itself. Returns Z_OK or Z_ENOMEM.
+static inline int zstr_rope_append_rope(zstr_rope *r, const zstr_rope *src)
+{
+    size_t n = src->count;
+    if (n == 0) return Z_OK;
+    if (zstr__rope_reserve(r, n) != Z_OK) return Z_ENOMEM;
+
+    // When src == r, the first push may merge into the last piece before it is read.
+    zstr_rope_piece tail = src->pieces[n - 1];
+    for (size_t i = 0; i < n; i++)
+    {
+        zstr_rope_piece p = (i == n - 1) ? tail : src->pieces[i];
+        if (p.chunk) ZSTR__ATOMIC_INC(&p.chunk->refs);
+        zstr__rope_push(r, p.chunk, p.data, p.len);
+    }
+    return Z_OK;
+}
+
+// Makes `out` a new rope holding bytes [start, start + len) of `r`, clamped like
+// zstr_sub. Chunks are shared, so the cost is O(log pieces + pieces in range).
+// `out` is overwritten (free it with zstr_rope_free). Returns Z_OK or Z_ENOMEM.
+static inline int zstr_rope_slice(const zstr_rope *r, size_t start, size_t len, zstr_rope *out)
+{
+    *out = zstr_rope_init();
+    if (start >= r->len) return Z_OK;
+    if (len > r->len - start) len = r->len - start;
+    if (len == 0) return Z_OK;
+
+    size_t first = zstr__rope_locate(r, start);
+    size_t last = zstr__rope_locate(r, start + len - 1);
+    if (zstr__rope_reserve(out, last - first + 1) != Z_OK) return Z_ENOMEM;
+
+    for (size_t i = first; i <= last; i++)
+    {
+        zstr_rope_piece p = r->pieces[i];
+        size_t p_start = p.end - p.len;
+        size_t lo = start > p_start ? start - p_start : 0;
+        size_t hi = start + len < p.end ? start + len - p_start : p.len;
+
+        if (p.chunk) ZSTR__ATOMIC_INC(&p.chunk->refs);
+        zstr__rope_push(out, p.chunk, p.data + lo, hi - lo);
+    }
+    return Z_OK;
+}
+
+// Returns the byte at `index` (O(log pieces)), or '\0' if out of range.
+static inline char zstr_rope_at(const zstr_rope *r, size_t index)
+{
+    if (index >= r->len) return '\0';
+    const zstr_rope_piece *p = &r->pieces[zstr__rope_locate(r, index)];
+    return p->data[index - (p->end - p->len)];
+}
+
+// Returns the number of contiguous pieces (e.g. iovec entries for writev).
+static inline size_t zstr_rope_chunk_count(const zstr_rope *r)
+{
+    return r->count;
+}
+
+// Borrows piece `i` (0 <= i < zstr_rope_chunk_count). Valid until the rope changes.
+static inline zstr_view zstr_rope_chunk(const zstr_rope *r, size_t i)
+{
+    zstr_view v;
+    v.data = r->pieces[i].data;
+    v.len = r->pieces[i].len;
+    return v;
+}
+
+// Initializes an iterator over the pieces of a rope, in order.
+static inline zstr_rope_iter zstr_rope_iter_init(const zstr_rope *r)
+{
+    zstr_rope_iter it;
+    it.rope = r;
+    it.index = 0;
+    return it;
+}
+
+// Gets the next piece. Returns false when done.
+static inline bool zstr_rope_next(zstr_rope_iter *it, zstr_view *out_chunk)
+{
+    if (it->index >= it->rope->count) return false;
+    *out_chunk = zstr_rope_chunk(it->rope, it->index++);
+    return true;
+}
+
+// Appends the bytes of a rope to `s` with a single reservation. Returns Z_OK or Z_ENOMEM.
+static inline int zstr_cat_rope(zstr *s, const zstr_rope *r)
+{
+    size_t cur_len = zstr_len(s);
+    if (zstr_reserve(s, cur_len + r->len) != Z_OK) return Z_ENOMEM;
+
+    char *dst = zstr_data(s) + cur_len;
+    for (size_t i = 0; i < r->count; i++)
+    {
+        memcpy(dst, r->pieces[i].data, r->pieces[i].len);
+        dst += r->pieces[i].len;
+    }
+    *dst = '\0';
+    zstr__set_len(s, cur_len + r->len);
+    return Z_OK;
+}
+
+// Flattens the rope into a new zstr (exactly sized). Returns an empty string on failure.
+static inline zstr zstr_rope_flatten(const zstr_rope *r)
+{
+    zstr s = zstr_init();
+    if (zstr_cat_rope(&s, r) != Z_OK) zstr_free(&s);
+    return s;
+}
+
+/* Scatter-Gather Output (POSIX) */
+
+#if defined(ZSTR_HAS_POSIX)
+
+// Segments passed to one writev call (further capped by IOV_MAX).
+#ifndef ZSTR_WRITEV_BATCH
+    #define ZSTR_WRITEV_BATCH 64
+#endif
+
+// Bytes passed to one writev call (some systems reject totals above INT_MAX).
+#ifndef ZSTR_WRITEV_MAX_BYTES
+    #define ZSTR_WRITEV_MAX_BYTES ((size_t)1 << 30)
+#endif
+
+// Internal: segment `i` of a write, whatever list it came from.
+static inline zstr_view zstr__writev_seg(const zstr_writev_state *st, size_t i)
+{
+    if (st->views) return st->views[i];
+    if (st->rope) return zstr_rope_chunk(st->rope, i);
+
+    zstr_view v;
+    v.data = zstr_cstr(&st->strs[i]);
+    v.len = zstr_len(&st->strs[i]);
+    return v;
+}
+
+// Internal: sums the segment lengths.
+static inline zstr_writev_state zstr__writev_start(zstr_writev_state st)
+{
+    st.index = 0;
+    st.offset = 0;
+    st.written = 0;
+    st.total = 0;
+    for (size_t i = 0; i < st.count; i++) st.total += zstr__writev_seg(&st, i).len;
+    return st;
+}
+
+// Prepares a write of `count` views, in order. Nothing is copied: the views
+// and their bytes must stay valid until the write is done.
+static inline zstr_writev_state zstr_writev_init_views(const zstr_view *views, size_t count)
+{
+    zstr_writev_state st;
+    memset(&st, 0, sizeof(st));
+    st.views = views;
+    st.count = count;
+    return zstr__writev_start(st);
+}
+
+// Prepares a write of an array of `count` strings (same lifetime rules).
+static inline zstr_writev_state zstr_writev_init_zstrs(const zstr *strs, size_t count)
+{
+    zstr_writev_state st;
+    memset(&st, 0, sizeof(st));
+    st.strs = strs;
+    st.count = count;
+    return zstr__writev_start(st);
+}
+
+// Prepares a write of a rope's pieces. The rope must not change until the write is done.
+static inline zstr_writev_state zstr_writev_init_rope(const zstr_rope *r)
+{
+    zstr_writev_state st;
+    memset(&st, 0, sizeof(st));
+    st.rope = r;
+    st.count = zstr_rope_chunk_count(r);
+    return zstr__writev_start(st);
+}
+
+// Returns true once every byte has been written.
+static inline bool zstr_writev_done(const zstr_writev_state *st)
+{
+    return st->written == st->total;
+}
+
+// Writes as much as the fd accepts with batched writev calls, resuming where the
+// previous call stopped. Short writes are continued and EINTR is retried.
+// Returns Z_OK when done or when a non-blocking fd reports EAGAIN (check
+// zstr_writev_done, wait for POLLOUT and call again), Z_ERR on any other error
+// (errno is kept).
+static inline int zstr_writev_resume(zstr_writev_state *st, int fd)
+{
+    int batch = ZSTR_WRITEV_BATCH;
+#if defined(IOV_MAX)
+    if (batch > IOV_MAX) batch = IOV_MAX;
+#endif
+
+    while (!zstr_writev_done(st))
+    {
+        struct iovec iov[ZSTR_WRITEV_BATCH];
+        int n = 0;
+        size_t bytes = 0;
+
+        for (size_t i = st->index, off = st->offset; i < st->count && n < batch; i++, off = 0)
+        {
+            zstr_view v = zstr__writev_seg(st, i);
+            size_t len = v.len - off;
+            if (len == 0) continue;
+            if (len > ZSTR_WRITEV_MAX_BYTES - bytes) len = ZSTR_WRITEV_MAX_BYTES - bytes;
+
+            iov[n].iov_base = (void *)(v.data + off);
+            iov[n].iov_len = len;
+            n++;
+            bytes += len;
+            if (bytes == ZSTR_WRITEV_MAX_BYTES) break;
+        }
+
+        ssize_t w = writev(fd, iov, n);
+        if (w < 0)
+        {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return Z_OK;
+            return Z_ERR;
+        }
+
+        // Advance past the bytes the kernel took (possibly mid-segment).
+        size_t left = (size_t)w;
+        st->written += left;
+        while (left)
+        {
+            size_t rem = zstr__writev_seg(st, st->index).len - st->offset;
+            if (left < rem)
+            {
+                st->offset += left;
+                break;
+            }
+            left -= rem;
+            st->index++;
+            st->offset = 0;
+        }
+    }
+    return Z_OK;
+}
+
+// Internal: runs a write to completion on a blocking fd.
+static inline int zstr__writev_all(zstr_writev_state *st, int fd)
+{
+    if (zstr_writev_resume(st, fd) != Z_OK) return Z_ERR;
+    if (zstr_writev_done(st)) return Z_OK;
+
+    // Only a non-blocking fd stops early; those need zstr_writev_resume.
+    errno = EAGAIN;
+    return Z_ERR;
+}
+
+// Blocking write of `count` views. Returns Z_OK or Z_ERR (errno is kept).
+static inline int zstr_write_views(int fd, const zstr_view *views, size_t count)
+{
+    zstr_writev_state st = zstr_writev_init_views(views, count);
+    return zstr__writev_all(&st, fd);
+}
+
+// Blocking write of an array of strings. Returns Z_OK or Z_ERR (errno is kept).
+static inline int zstr_write_zstrs(int fd, const zstr *strs, size_t count)
+{
+    zstr_writev_state st = zstr_writev_init_zstrs(strs, count);
+    return zstr__writev_all(&st, fd);
+}
+
+// Blocking write of a rope without flattening it. Returns Z_OK or Z_ERR (errno is kept).
+static inline int zstr_write_rope(int fd, const zstr_rope *r)
+{
+    zstr_writev_state st = zstr_writev_init_rope(r);
+    return zstr__writev_all(&st, fd);
+}
+
+#endif // ZSTR_HAS_POSIX
+
+
+/* Memory-Mapped Files (POSIX) */
+
+#if defined(ZSTR_HAS_POSIX)
+
+// Access pattern hints for zstr_mmap_file / zstr_mmap_advise (posix_madvise).
+#define ZSTR_MMAP_NORMAL     0
+#define ZSTR_MMAP_SEQUENTIAL 1  // Aggressive read-ahead, pages can be dropped behind the scan.
+#define ZSTR_MMAP_RANDOM     2  // No read-ahead.
+#define ZSTR_MMAP_WILLNEED   3  // Start reading the whole range in now.
+#define ZSTR_MMAP_DONTNEED   4  // Done with the range; the kernel may reclaim it.
+
+// Internal: maps a ZSTR_MMAP_* hint to its posix_madvise value.
+static inline int zstr__mmap_hint(int advice)
+{
+#if defined(POSIX_MADV_NORMAL)
+    switch (advice)
+    {
+        case ZSTR_MMAP_SEQUENTIAL: return POSIX_MADV_SEQUENTIAL;
+        case ZSTR_MMAP_RANDOM:     return POSIX_MADV_RANDOM;
+        case ZSTR_MMAP_WILLNEED:   return POSIX_MADV_WILLNEED;
+        case ZSTR_MMAP_DONTNEED:   return POSIX_MADV_DONTNEED;
+        default:                   return POSIX_MADV_NORMAL;
+    }
+#else
+    return advice;
+#endif
+}
+
+// Applies an access hint to bytes [offset, offset + len) of a mapping (clamped).
+// Useful to drop pages behind a long scan with ZSTR_MMAP_DONTNEED. A no-op where
+// posix_madvise is not declared (e.g. strict -std=c11 without _POSIX_C_SOURCE).
+static inline void zstr_mmap_advise_range(const zstr_mmap *m, size_t offset, size_t len, int advice)
+{
+    if (offset >= m->len) return;
+    if (len > m->len - offset) len = m->len - offset;
+
+#if defined(POSIX_MADV_NORMAL)
+    // posix_madvise wants a page-aligned start.
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t skew = offset % page;
+    posix_madvise((void *)(m->data + offset - skew), len + skew, zstr__mmap_hint(advice));
+#else
+    (void)advice;
+#endif
+}
+
+// Applies an access hint to the whole mapping.
+static inline void zstr_mmap_advise(const zstr_mmap *m, int advice)
+{
+    zstr_mmap_advise_range(m, 0, m->len, advice);
+}
+
+// Maps a file read-only instead of copying it into a zstr, so scans (split,
+// find, UTF-8 checks) run straight over the page cache and start before the
+// whole file has been read. `advice` is a ZSTR_MMAP_* hint. Empty files give
+// an empty mapping. Returns Z_OK, or Z_ERR if the file cannot be opened or
+// mapped (pipes, most /proc files); errno is kept. Use zstr_read_file for those.
+static inline int zstr_mmap_file(zstr_mmap *m, const char *path, int advice)
+{
+    m->data = "";
+    m->len = 0;
+
+    int flags = O_RDONLY;
+#if defined(O_CLOEXEC)
+    flags |= O_CLOEXEC;
+#endif
+    int fd = open(path, flags);
+    if (fd < 0) return Z_ERR;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return Z_ERR;
+    }
+
+    if (!S_ISREG(st.st_mode) || (uint64_t)st.st_size > (uint64_t)SIZE_MAX)
+    {
+        close(fd);
+        errno = S_ISREG(st.st_mode) ? EFBIG : ENODEV;
+        return Z_ERR;
+    }
+
+    size_t len = (size_t)st.st_size;
+    if (len == 0)
+    {
+        close(fd);
+        return Z_OK;
+    }
+
+    void *p = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    int err = errno;
+    close(fd);  // The mapping keeps its own reference to the file.
+    if (p == MAP_FAILED)
+    {
+        errno = err;
+        return Z_ERR;
+    }
+
+    m->data = (const char *)p;
+    m->len = len;
+    if (advice != ZSTR_MMAP_NORMAL) zstr_mmap_advise(m, advice);
+    return Z_OK;
+}
+
+// Borrows the mapped bytes. Valid until zstr_mmap_free.
+static inline zstr_view zstr_mmap_view(const zstr_mmap *m)
+{
+    zstr_view v;
+    v.data = m->data;
+    v.len = m->len;
+    return v;
+}
+
+// Unmaps the file and resets `m` to empty.
+static inline void zstr_mmap_free(zstr_mmap *m)
+{
+    if (m->len) munmap((void *)m->data, m->len);
+    m->data = "";
+    m->len = 0;
+}
+
+#endif // ZSTR_HAS_POSIX
+
+
+/* Streaming Line Reader (POSIX) */
+
+#if defined(ZSTR_HAS_POSIX)
+
+// Default read size of a line reader.
+#ifndef ZSTR_LINE_BLOCK
+    #define ZSTR_LINE_BLOCK (64 * 1024)
+#endif
+
+// Prepares a reader over `fd` (not owned: zstr_line_reader_free leaves it open).
+// `block_size` is the read size and initial buffer (0 = ZSTR_LINE_BLOCK); the
+// buffer doubles when a single line is longer. Returns Z_OK or Z_ENOMEM.
+static inline int zstr_line_reader_init(zstr_line_reader *r, int fd, size_t block_size)
+{
+    memset(r, 0, sizeof(*r));
+    r->fd = fd;
+    r->block_size = block_size ? block_size : ZSTR_LINE_BLOCK;
+    r->buf = Z_STR_MALLOC(r->block_size);
+    if (!r->buf) return Z_ENOMEM;
+    r->cap = r->block_size;
+    return Z_OK;
+}
+
+// Releases the buffer. Views returned by the reader become invalid.
+static inline void zstr_line_reader_free(zstr_line_reader *r)
+{
+    Z_STR_FREE(r->buf);
+    r->buf = NULL;
+    r->cap = r->start = r->end = r->scan = 0;
+    r->mask = 0;
+}
+
+// Internal: moves the unfinished line to the front (growing the buffer when the
+// line fills it) and reads the next block. Returns Z_OK, Z_ENOMEM or Z_ERR.
+static inline int zstr__line_reader_fill(zstr_line_reader *r)
+{
+    if (r->start > 0)
+    {
+        size_t keep = r->end - r->start;
+        memmove(r->buf, r->buf + r->start, keep);
+        r->scan -= r->start;
+        r->end = keep;
+        r->start = 0;
+    }
+
+    if (r->end == r->cap)
+    {
+        char *buf = Z_STR_REALLOC(r->buf, r->cap * 2);
+        if (!buf)
+        {
+            r->error = ENOMEM;
+            return Z_ENOMEM;
+        }
+        r->buf = buf;
+        r->cap *= 2;
+    }
+
+    size_t want = r->cap - r->end;
+    if (want > r->block_size) want = r->block_size;
+
+    r->error = 0;
+    for (;;)
+    {
+        ssize_t n = read(r->fd, r->buf + r->end, want);
+        if (n > 0)
+        {
+            r->end += (size_t)n;
+            return Z_OK;
+        }
+        if (n == 0)
+        {
+            r->eof = true;
+            return Z_OK;
+        }
+        if (errno != EINTR)
+        {
+            r->error = errno;
+            return Z_ERR;
+        }
+    }
+}
+
+// Gets the next line without its '\n' (a '\r' before it is kept). The view
+// points into the reader's buffer and is valid until the next call. A last
+// line without a newline is still returned. Newlines are found 32 bytes at a
+// time with SIMD compares. Returns false at the end of the input or on a read
+// error (zstr_line_reader_error); on a non-blocking fd an EAGAIN error leaves
+// the reader intact, so call again once the fd is readable.
+static inline bool zstr_line_reader_next(zstr_line_reader *r, zstr_view *out_line)
+{
+    for (;;)
+    {
+        if (r->mask)
+        {
+            size_t pos = r->mask_base + zstr__ctz32(r->mask);
+            r->mask &= r->mask - 1;
+            out_line->data = r->buf + r->start;
+            out_line->len = pos - r->start;
+            r->start = pos + 1;
+            return true;
+        }
+
+        if (r->scan + 32 <= r->end)
+        {
+            r->mask_base = r->scan;
+            r->mask = zstr__byte_mask32(r->buf + r->scan, '\n');
+            r->scan += 32;
+            continue;
+        }
+
+        if (r->scan < r->end)
+        {
+            const char *hit = (const char *)memchr(r->buf + r->scan, '\n', r->end - r->scan);
+            if (hit)
+            {
+                size_t pos = (size_t)(hit - r->buf);
+                r->scan = pos + 1;
+                out_line->data = r->buf + r->start;
+                out_line->len = pos - r->start;
+                r->start = pos + 1;
+                return true;
+            }
+            r->scan = r->end;
+        }
+
+        if (r->eof)
+        {
+            if (r->start == r->end) return false;
+            out_line->data = r->buf + r->start;
+            out_line->len = r->end - r->start;
+            r->start = r->end;
+            return true;
+        }
+
+        if (!r->buf || zstr__line_reader_fill(r) != Z_OK) return false;
+    }
+}
+
+// Returns the errno of the last failed read (0 if none, EAGAIN on an empty non-blocking fd).
+static inline int zstr_line_reader_error(const zstr_line_reader *r)
+{
+    return r->error;
+}
+
+#endif // ZSTR_HAS_POSIX
+
+
+/* Batch File Loading (POSIX) */
+
+#if defined(ZSTR_HAS_POSIX)
+
+// Threads (including the caller) used by the zstr_read_files fallback.
+#ifndef ZSTR_READ_THREADS
+    #define ZSTR_READ_THREADS 8
+#endif
+
+// Operations kept in flight by the io_uring backend (rounded up by the kernel).
+#ifndef ZSTR_URING_DEPTH
+    #define ZSTR_URING_DEPTH 256
+#endif
+
+// Internal: shared state of one zstr_read_files call.
+typedef struct {
+    const char *const *paths;
+    zstr *out;
+    int *status;
+    size_t count;
+    size_t next;        // Next file to claim (thread pool).
+    size_t failed;
+    uint8_t alloc;      // Caller's allocator, used by every worker.
+} zstr__batch;
+
+// Internal: records the result of file `i`.
+static inline void zstr__batch_finish(zstr__batch *b, size_t i, int rc)
+{
+    if (rc != Z_OK)
+    {
+        zstr_free(&b->out[i]);
+        ZSTR__ATOMIC_INC(&b->failed);
+    }
+    if (b->status) b->status[i] = rc;
+}
+
+// Internal: claims files one at a time and reads them with zstr__read_path.
+static inline void zstr__batch_run(zstr__batch *b)
+{
+    uint8_t *scope = zstr__allocator_scope();
+    uint8_t prev = *scope;
+    *scope = b->alloc;
+
+    for (;;)
+    {
+        size_t i = ZSTR__ATOMIC_INC(&b->next) - 1;
+        if (i >= b->count) break;
+        zstr__batch_finish(b, i, zstr__read_path(&b->out[i], b->paths[i]));
+    }
+    *scope = prev;
+}
+
+#if defined(ZSTR_HAS_THREADS)
+static inline void* zstr__batch_worker(void *arg)
+{
+    zstr__batch_run((zstr__batch *)arg);
+    return NULL;
+}
+#endif
+
+#if defined(ZSTR_HAS_IO_URING)
+
+// Internal: submission and completion rings mapped from the kernel.
+typedef struct {
+    int fd;
+    unsigned entries;
+    unsigned *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ptr, *cq_ptr;
+    size_t sq_len, cq_len;
+    unsigned to_submit;
+} zstr__uring;
+
+// Internal: progress of one file in the io_uring pipeline.
+typedef struct {
+    size_t off;
+    size_t size;
+    int fd;
+    bool done;
+    bool busy;          // An operation on this file has been queued and not completed.
+} zstr__uring_file;
+
+// Internal: operation tags in the low bit of user_data.
+#define ZSTR__URING_OPEN 0
+#define ZSTR__URING_READ 1
+
+// Internal: unmaps the rings and closes the ring fd.
+static inline void zstr__uring_exit(zstr__uring *r)
+{
+    if (r->sqes) munmap(r->sqes, r->entries * sizeof(struct io_uring_sqe));
+    if (r->cq_ptr && r->cq_ptr != r->sq_ptr) munmap(r->cq_ptr, r->cq_len);
+    if (r->sq_ptr) munmap(r->sq_ptr, r->sq_len);
+    close(r->fd);
+}
+
+// Internal: creates a ring and checks that the kernel supports openat and
+// read. Returns Z_OK, or Z_ERR when io_uring is unavailable (old kernel,
+// seccomp, io_uring_disabled).
+static inline int zstr__uring_init(zstr__uring *r, unsigned depth)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(r, 0, sizeof(*r));
+
+    int fd = (int)syscall(__NR_io_uring_setup, depth, &p);
+    if (fd < 0) return Z_ERR;
+    r->fd = fd;
+    r->entries = p.sq_entries;
+
+    r->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single && r->cq_len > r->sq_len) r->sq_len = r->cq_len;
+
+    void *sq = mmap(NULL, r->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, IORING_OFF_SQ_RING);
+    void *cq = single ? sq : mmap(NULL, r->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, IORING_OFF_CQ_RING);
+    void *sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, IORING_OFF_SQES);
+    r->sq_ptr = sq == MAP_FAILED ? NULL : sq;
+    r->cq_ptr = cq == MAP_FAILED ? NULL : cq;
+    r->sqes = sqes == MAP_FAILED ? NULL : (struct io_uring_sqe *)sqes;
+    if (!r->sq_ptr || !r->cq_ptr || !r->sqes)
+    {
+        zstr__uring_exit(r);
+        return Z_ERR;
+    }
+
+    r->sq_tail  = (unsigned *)((char *)sq + p.sq_off.tail);
+    r->sq_mask  = (unsigned *)((char *)sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)((char *)sq + p.sq_off.array);
+    r->cq_head  = (unsigned *)((char *)cq + p.cq_off.head);
+    r->cq_tail  = (unsigned *)((char *)cq + p.cq_off.tail);
+    r->cq_mask  = (unsigned *)((char *)cq + p.cq_off.ring_mask);
+    r->cqes     = (struct io_uring_cqe *)((char *)cq + p.cq_off.cqes);
+
+    // The file opcodes arrived in 5.6, together with IORING_REGISTER_PROBE.
+    size_t probe_size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = (struct io_uring_probe *)Z_CALLOC(1, probe_size);
+    bool ok = probe && syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0 &&
+              probe->last_op >= IORING_OP_READ &&
+              (probe->ops[IORING_OP_OPENAT].flags & IO_URING_OP_SUPPORTED) &&
+              (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED);
+    Z_FREE(probe);
+    if (!ok)
+    {
+        zstr__uring_exit(r);
+        return Z_ERR;
+    }
+    return Z_OK;
+}
+
+// Internal: queues one operation (the caller keeps at most `entries` in flight).
+static inline void zstr__uring_push(zstr__uring *r, uint8_t op, int fd, const void *addr,
+                                    unsigned len, uint64_t off, size_t file, uint8_t tag)
+{
+    unsigned tail = *r->sq_tail;
+    unsigned idx = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = op;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)addr;
+    sqe->len = len;
+    sqe->off = off;
+    sqe->user_data = ((uint64_t)file << 1) | tag;
+    if (op == IORING_OP_OPENAT)
+    {
+        int flags = O_RDONLY;
+#if defined(O_CLOEXEC)
+        flags |= O_CLOEXEC;
+#endif
+        sqe->open_flags = (uint32_t)flags;
+    }
+
+    r->sq_array[idx] = idx;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    r->to_submit++;
+}
+
+// Internal: queues the next read of file `i` (at most 1 GiB per request).
+static inline void zstr__uring_read(zstr__uring *r, zstr__batch *b, zstr__uring_file *f, size_t i)
+{
+    size_t want = f->size - f->off;
+    if (want > ((size_t)1 << 30)) want = (size_t)1 << 30;
+    f->busy = true;
+    zstr__uring_push(r, IORING_OP_READ, f->fd, zstr_data(&b->out[i]) + f->off,
+                     (unsigned)want, f->off, i, ZSTR__URING_READ);
+}
+
+// Internal: ends the pipeline of file `i`.
+static inline void zstr__uring_done(zstr__batch *b, zstr__uring_file *f, size_t i, int rc)
+{
+    if (f->fd >= 0) close(f->fd);
+    f->fd = -1;
+    f->done = true;
+    zstr__batch_finish(b, i, rc);
+}
+
+// Internal: the open of file `i` completed with `res`. Regular files get an
+// exactly sized buffer and a read; anything else is read synchronously.
+// Returns the number of operations queued (0 or 1).
+static inline int zstr__uring_opened(zstr__uring *r, zstr__batch *b, zstr__uring_file *f, size_t i, int res)
+{
+    struct stat st;
+    if (res < 0)
+    {
+        errno = -res;
+        zstr__uring_done(b, f, i, Z_ERR);
+        return 0;
+    }
+    f->fd = res;
+
+    // fstat on an open descriptor is cheap; a ring statx would repeat the path walk.
+    if (fstat(f->fd, &st) != 0)
+    {
+        zstr__uring_done(b, f, i, Z_ERR);
+        return 0;
+    }
+    if (S_ISDIR(st.st_mode))
+    {
+        errno = EISDIR;
+        zstr__uring_done(b, f, i, Z_ERR);
+        return 0;
+    }
+    if (!S_ISREG(st.st_mode) || st.st_size <= 0 || (uint64_t)st.st_size >= (uint64_t)SIZE_MAX)
+    {
+        // /proc files, pipes and FIFOs have no usable size.
+        zstr__uring_done(b, f, i, zstr_read_fd(&b->out[i], f->fd));
+        return 0;
+    }
+
+    f->size = (size_t)st.st_size;
+    if (zstr_reserve(&b->out[i], f->size) != Z_OK)
+    {
+        zstr__uring_done(b, f, i, Z_ENOMEM);
+        return 0;
+    }
+    zstr__uring_read(r, b, f, i);
+    return 1;
+}
+
+// Internal: after a ring error, waits for the `submitted` operations the kernel
+// already owns, so that no read lands in a buffer the fallback frees or reuses.
+// Descriptors from late opens are kept in their file entry for the caller to
+// close. Returns false if the ring cannot be waited on.
+static inline bool zstr__uring_drain(zstr__uring *r, zstr__uring_file *files, unsigned submitted)
+{
+    while (submitted > 0)
+    {
+        int n = (int)syscall(__NR_io_uring_enter, r->fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (n < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) return false;
+
+        unsigned head = *r->cq_head;
+        unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++)
+        {
+            struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+            zstr__uring_file *f = &files[cqe->user_data >> 1];
+            f->busy = false;
+            if ((cqe->user_data & 1) == ZSTR__URING_OPEN && cqe->res >= 0) f->fd = cqe->res;
+            submitted--;
+        }
+        __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+    }
+    return true;
+}
+
+// Internal: loads every file through one ring: the opens of many files are in
+// flight at once, and each read is queued as soon as its file is open. Regular
+// files are read up to the size fstat reported. Returns Z_ERR
+// without touching any file when io_uring is unavailable.
+static inline int zstr__read_files_uring(zstr__batch *b)
+{
+    zstr__uring r;
+    if (zstr__uring_init(&r, ZSTR_URING_DEPTH) != Z_OK) return Z_ERR;
+
+    zstr__uring_file *files = (zstr__uring_file *)Z_CALLOC(b->count, sizeof(zstr__uring_file));
+    if (!files)
+    {
+        zstr__uring_exit(&r);
+        return Z_ERR;
+    }
+
+    size_t next = 0, done = 0;
+    unsigned inflight = 0;
+    int rc = Z_OK;
+
+    while (done < b->count)
+    {
+        for (; next < b->count && inflight < r.entries; next++)
+        {
+            files[next].fd = -1;
+            files[next].busy = true;
+            zstr__uring_push(&r, IORING_OP_OPENAT, AT_FDCWD, b->paths[next], 0, 0, next, ZSTR__URING_OPEN);
+            inflight++;
+        }
+
+        int n = (int)syscall(__NR_io_uring_enter, r.fd, r.to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (n < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+        {
+            rc = Z_ERR;
+            break;
+        }
+        if (n > 0) r.to_submit -= (unsigned)n;
+
+        unsigned head = *r.cq_head;
+        unsigned tail = __atomic_load_n(r.cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++)
+        {
+            struct io_uring_cqe *cqe = &r.cqes[head & *r.cq_mask];
+            size_t i = (size_t)(cqe->user_data >> 1);
+            int res = cqe->res;
+            zstr__uring_file *f = &files[i];
+            f->busy = false;
+            inflight--;
+
+            if ((cqe->user_data & 1) == ZSTR__URING_OPEN)
+            {
+                if (zstr__uring_opened(&r, b, f, i, res)) inflight++;
+                else done++;
+            }
+            else if (res == -EINTR || res == -EAGAIN)
+            {
+                zstr__uring_read(&r, b, f, i);
+                inflight++;
+            }
+            else if (res < 0)
+            {
+                errno = -res;
+                zstr__uring_done(b, f, i, Z_ERR);
+                done++;
+            }
+            else
+            {
+                f->off += (size_t)res;
+                zstr_data(&b->out[i])[f->off] = '\0';
+                zstr__set_len(&b->out[i], f->off);
+                if (res > 0 && f->off < f->size)
+                {
+                    zstr__uring_read(&r, b, f, i);
+                    inflight++;
+                }
+                else
+                {
+                    zstr__uring_done(b, f, i, Z_OK);
+                    done++;
+                }
+            }
+        }
+        __atomic_store_n(r.cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    // The ring failed mid-way (not expected once it is set up). Closing it does
+    // not cancel requests the kernel already took, so wait for those first;
+    // queued but never submitted entries do not run.
+    bool drained = rc == Z_OK || zstr__uring_drain(&r, files, inflight - r.to_submit);
+    zstr__uring_exit(&r);
+
+    // Read whatever is unfinished synchronously. If the ring could not be
+    // drained, buffers that may still be written to are abandoned, not freed.
+    if (rc != Z_OK)
+    {
+        for (size_t i = 0; i < b->count; i++)
+        {
+            if (files[i].done) continue;
+            if (i < next && files[i].fd >= 0) close(files[i].fd);
+            if (!drained && files[i].busy) b->out[i] = zstr_init();
+            else zstr_free(&b->out[i]);
+            zstr__batch_finish(b, i, zstr__read_path(&b->out[i], b->paths[i]));
+        }
+    }
+    Z_FREE(files);
+    return Z_OK;
+}
+
+#endif // ZSTR_HAS_IO_URING
+
+// Loads `count` files into out[0..count) (the array is overwritten). Opens,
+// stats and reads overlap: Linux uses an io_uring pipeline when the kernel
+// allows it, other systems (or a refused ring) spread the files over up to
+// ZSTR_READ_THREADS threads. Every string is read with the caller's current
+// allocator, which must then be thread-safe. out[i] is empty for files that
+// failed; `status` (optional) receives Z_OK / Z_ERR / Z_ENOMEM per file.
+// Returns Z_OK if every file was loaded, Z_ERR otherwise.
+static inline int zstr_read_files(const char *const *paths, size_t count, zstr *out, int *status)
+{
+    zstr__batch b;
+    memset(&b, 0, sizeof(b));
+    b.paths = paths;
+    b.out = out;
+    b.status = status;
+    b.count = count;
+    b.alloc = *zstr__allocator_scope();
+
+    for (size_t i = 0; i < count; i++) out[i] = zstr_init();
+    if (count == 0) return Z_OK;
+
+#if defined(ZSTR_HAS_IO_URING)
+    if (count > 1 && zstr__read_files_uring(&b) == Z_OK) return b.failed ? Z_ERR : Z_OK;
+#endif
+
+#if defined(ZSTR_HAS_THREADS)
+    pthread_t threads[ZSTR_READ_THREADS];
+    size_t spawned = 0;
+    size_t want = count < ZSTR_READ_THREADS ? count : ZSTR_READ_THREADS;
+    for (; spawned + 1 < want; spawned++)
+    {
+        if (pthread_create(&threads[spawned], NULL, zstr__batch_worker, &b) != 0) break;
+    }
+    zstr__batch_run(&b);
+    for (size_t t = 0; t < spawned; t++) pthread_join(threads[t], NULL);
+#else
+    zstr__batch_run(&b);
+#endif
+
+    return b.failed ? Z_ERR : Z_OK;
+}
+
+#endif // ZSTR_HAS_POSIX
+
+#if defined(Z_HAS_CLEANUP) && Z_HAS_CLEANUP
+    #define zstr_autofree  Z_CLEANUP(zstr_free) zstr
+#endif
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+/* C++ Integration Layer -> namespace: zstr */
+
+#ifdef __cplusplus
+
+#include <utility>
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <iterator>
+#include <functional>
+#include <new>
+#include <cstdlib>
+
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+// Allocation failure in a wrapper constructor: std::bad_alloc, or abort when
+// exceptions are disabled.
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND)
+    #define ZSTR__THROW_BAD_ALLOC() throw std::bad_alloc()
+#else
+    #define ZSTR__THROW_BAD_ALLOC() std::abort()
+#endif
+
+namespace z_str
+{
+    class string;
+
+    class view
+    {
+        ::zstr_view inner;
+
+     public:
+        // Iterator traits for view.
+        using value_type      = char;
+        using size_type       = size_t;
+        using difference_type = std::ptrdiff_t;
+        using const_pointer   = const char*;
+        using const_iterator  = const char*;
+
+        view() : inner{NULL, 0} {}
+        view(const char *s) : inner(::zstr_view_from(s)) {}
+        view(const char *s, size_t len) : inner{s, len}  {}
+        
+        // Defined later to allow cyclic dependency.
+        view(const string &s);
+        view(const string &&) = delete;
+
+        const char *data() const { return inner.data; }
+        size_t size() const      { return inner.len; }
+        size_t length() const    { return inner.len; }
+        bool empty() const       { return inner.len == 0; }
+
+        const char *begin() const { return inner.data; }
+        const char *end() const   { return inner.data + inner.len; }
+
+        char operator[](size_t idx) const { return inner.data[idx]; }
+
+#       if __cplusplus >= 201703L
+        operator std::string_view() const { return std::string_view(data(), size()); }
+#       endif
+
+        bool starts_with(const char *prefix) const { return ::zstr_view_starts_with(inner, prefix); }
+        bool ends_with(const char *suffix) const   { return ::zstr_view_ends_with(inner, suffix); }
+        bool equals(const char *str) const         { return ::zstr_view_eq(inner, str); }
+
+        // Search.
+        std::ptrdiff_t find(view needle) const { return ::zstr_view_find(inner, needle.inner); }
+        bool contains(view needle) const       { return ::zstr_view_contains(inner, needle.inner); }
+        bool is_valid_utf8() const             { return ::zstr_view_is_valid_utf8(inner); }
+        size_t rune_count() const              { return ::zstr_view_count_runes(inner); }
+
+        view sub(size_t start, size_t len) const
+        {
+            ::zstr_view v = ::zstr_sub(inner, start, len);
+            return view(v.data, v.len);
+        }
+
+        view lstrip() const
+        {
+            ::zstr_view v = ::zstr_view_lstrip(inner);
+            return view(v.data, v.len);
+        }
+
+        view rstrip() const
+        {
+            ::zstr_view v = ::zstr_view_rstrip(inner);
+            return view(v.data, v.len);
+        }
+
+        view trim() const
+        {
+            ::zstr_view v = ::zstr_view_trim(inner);
+            return view(v.data, v.len);
+        }
+
+        // Returns true if parsing was successful.
+        bool to_int(int *out) const { return ::zstr_view_to_int(inner, out); }
+
+        // Batch split: writes up to `cap` fields into `out`, returns the total field count.
+        size_t split_into(view delim, view *out, size_t cap) const
+        {
+            return ::zstr_split_into(inner, delim.inner, reinterpret_cast<::zstr_view*>(out), cap);
+        }
+
+        size_t split_count(view delim) const { return ::zstr_split_count(inner, delim.inner); }
+
+        // Hashing (same value as string::hash for equal bytes).
+        uint64_t hash() const                    { return ::zstr_view_hash(inner); }
+        uint64_t hash(uint64_t seed) const       { return ::zstr_view_hash_seeded(inner, seed); }
+
+        // Comparisons.
+        bool operator==(const char* other) const { return ::zstr_view_eq(inner, other); }
+        bool operator==(const view& other) const { return ::zstr_view_eq_view(inner, other.inner); }
+        bool operator!=(const char* other) const { return !(*this == other); }
+        bool operator!=(const view& other) const { return !(*this == other); }
+    };
+
+    // split_into() writes views through a ::zstr_view pointer.
+    static_assert(sizeof(view) == sizeof(::zstr_view), "z_str::view must wrap a bare zstr_view");
+
+    class split_iterable
+    {
+        ::zstr_view source;
+        const char *delim;
+     public:
+        split_iterable(::zstr_view s, const char *d) : source(s), delim(d) {}
+
+        struct iterator 
+        {
+            using iterator_category = std::input_iterator_tag;
+            using value_type        = view;
+            using difference_type   = std::ptrdiff_t;
+            using pointer           = const view*;
+            using reference         = const view&;
+
+            ::zstr_split_iter state;
+            ::zstr_view current_part;
+            bool done;
+
+            iterator(::zstr_view s, const char *d, bool end) : done(end)
+            {
+                if (!end)
+                {
+                    state = ::zstr_split_init(s, d);
+                    next();
+                }
+            }
+
+            void next() 
+            {
+                if (!::zstr_split_next(&state, &current_part))
+                {
+                    done = true;
+                }
+            }
+
+            view operator*() const { return view(current_part.data, current_part.len); }
+            iterator& operator++() { next(); return *this; }
+            bool operator!=(const iterator& other) const { return done != other.done; }
+            bool operator==(const iterator& other) const { return done == other.done; }
+        };
+
+        iterator begin() { return iterator(source, delim, false); }
+        iterator end()   { return iterator(source, delim, true); }
+    };
+
+    class string
+    {
+        ::zstr inner;
+        friend class view;
+        friend class searcher;
+        friend class shared;
+        friend class rope;
+        friend class rune_index;
+
+        friend bool operator==(const string& lhs, const string& rhs);
+        friend bool operator!=(const string& lhs, const string& rhs);
+        friend bool operator<(const string& lhs, const string& rhs);
+
+     public:
+        // Iterator traits.
+        using value_type      = char;
+        using size_type       = size_t;
+        using difference_type = std::ptrdiff_t;
+        using pointer         = char*;
+        using const_pointer   = const char*;
+        using iterator        = char*;
+        using const_iterator  = const char*;
+
+        // Default constructor.
+        string() : inner(::zstr_init()) {}
+
+        // C-string constructor.
+        string(const char *s) : inner(::zstr_from(s)) {}
+
+        // Length constructor.
+        string(const char *s, size_t len) : inner(::zstr_from_len(s, len)) {}
+
+        // This one is for C++17 so we put it like this.
+#       if __cplusplus >= 201703L
+        string(std::string_view sv) : inner(::zstr_from_len(sv.data(), sv.size())) {}
+#       endif
+
+        // Copy constructor.
+        string(const string &other) : inner(::zstr_dup(&other.inner)) {}
+
+        // Move constructor (zero cost).
+        string(string &&other) noexcept : inner(other.inner) 
+        {
+        other.inner = ::zstr_init();
+        }
+
+        // Destructor.
+        ~string() { ::zstr_free(&inner); }
+
+        // Copy assignment.
+        string& operator=(const string &other)
+        {
+            if (this != &other)
+            {
+                ::zstr_free(&inner);
+                inner = ::zstr_dup(&other.inner);
+            }
+            return *this;
+        }
+
+        // Move assignment (transfer ownership).
+        string& operator=(string &&other) noexcept
+        {
+            if (this != &other)
+            {
+                ::zstr_free(&inner);
+                inner = other.inner;
+                other.inner = ::zstr_init();
+            }
+            return *this;
+        }
+
+        // Assignment from C-string.
+        string& operator=(const char *s)
+        {
+            ::zstr_free(&inner);
+            inner = ::zstr_from(s);
+            return *this;
+        }
+
+        // Accessors.
+        const char *c_str() const { return ::zstr_cstr(&inner); }
+        const char *data() const  { return ::zstr_cstr(&inner); }
+        char *data()              { return ::zstr_data(&inner); }
+        size_t size() const       { return ::zstr_len(&inner); }
+        size_t length() const     { return ::zstr_len(&inner); }
+        size_t capacity() const   { return ::zstr_capacity(&inner); }
+        bool is_empty() const     { return ::zstr_is_empty(&inner); }
+
+#       if __cplusplus >= 201703L
+        operator std::string_view() const { return std::string_view(data(), size()); }
+#       endif
+
+        // Iterators.
+        char *begin()             { return ::zstr_data(&inner); }
+        char *end()               { return ::zstr_data(&inner) + size(); }
+        const char *begin() const { return ::zstr_cstr(&inner); }
+        const char *end() const   { return ::zstr_cstr(&inner) + size(); }
+
+        char& operator[](size_t idx)             { return ::zstr_data(&inner)[idx]; }
+        const char& operator[](size_t idx) const { return ::zstr_cstr(&inner)[idx]; }
+
+        char& front()             { return operator[](0); }
+        const char& front() const { return operator[](0); }
+        
+        char& back()              { return operator[](size() - 1); }
+        const char& back() const  { return operator[](size() - 1); }
+
+        // Modifiers.
+        void clear()             { ::zstr_clear(&inner); }
+        void reserve(size_t cap) { ::zstr_reserve(&inner, cap); }
+        void shrink_to_fit()     { ::zstr_shrink_to_fit(&inner); }
+        int set_allocator(int id) { return ::zstr_set_allocator(&inner, id); }
+        
+        void push_back(char c) { ::zstr_push_char(&inner, c); }
+        void pop_back()        { ::zstr_pop_char(&inner); }
+        
+        string& append(const char *s)             { ::zstr_cat(&inner, s); return *this; }
+        string& append(const char *s, size_t len) { ::zstr_cat_len(&inner, s, len); return *this; }
+
+        // Operators.
+        string& operator+=(const char *s)       { return append(s); }
+        string& operator+=(char c)              { push_back(c); return *this; }
+        string& operator+=(const string &other) { return append(other.c_str(), other.size()); }
+
+        // Search
+        std::ptrdiff_t find(const char *needle) const { return ::zstr_find(&inner, needle); }
+        std::ptrdiff_t find(view needle) const        { return ::zstr_find_len(&inner, needle.data(), needle.size()); }
+        bool contains(const char *needle) const       { return ::zstr_contains(&inner, needle); }
+        bool contains(view needle) const              { return find(needle) != -1; }
+        bool starts_with(const char *prefix) const    { return ::zstr_starts_with(&inner, prefix); }
+        bool ends_with(const char *suffix) const      { return ::zstr_ends_with(&inner, suffix); }
+
+        // Hashing (same value as view::hash for equal bytes).
+        uint64_t hash() const              { return ::zstr_hash(&inner); }
+        uint64_t hash(uint64_t seed) const { return ::zstr_hash_seeded(&inner, seed); }
+
+        // Some utilities.
+        void to_lower() { ::zstr_to_lower(&inner); }
+        void to_upper() { ::zstr_to_upper(&inner); }
+        void trim()     { ::zstr_trim(&inner); }
+
+        // Lowercase / uppercase copies, mapped in the same pass as the copy.
+        string lower() const
+        {
+            string out;
+            ::zstr_to_lower_into(&out.inner, ::zstr_as_view(&inner));
+            return out;
+        }
+
+        string upper() const
+        {
+            string out;
+            ::zstr_to_upper_into(&out.inner, ::zstr_as_view(&inner));
+            return out;
+        }
+
+        void replace(view target, view replacement)
+        {
+            ::zstr_replace_len(&inner, target.data(), target.size(), replacement.data(), replacement.size());
+        }
+
+        // Ownership.
+        // WARNING: Returns a raw malloc'd pointer. You MUST free() this yourself.
+        // The string object becomes empty after this call.
+        char* release() { return ::zstr_take(&inner); }
+
+        static string own(char *ptr, size_t len, size_t cap) 
+        {
+            string s;
+            s.inner = ::zstr_own(ptr, len, cap);
+            return s;
+        }
+
+        // UTF-8.
+        size_t rune_count() const    { return ::zstr_count_runes(&inner); }
+        bool is_valid_utf8() const   { return ::zstr_is_valid_utf8(&inner); }
+
+        // UTF-16 / UTF-32 copies. Conversion stops at the first invalid sequence.
+        std::u16string to_utf16() const
+        {
+            std::u16string out(::zstr_view_utf16_len(::zstr_as_view(&inner)), u'\0');
+            ::zstr_transcode_result r = ::zstr_to_utf16(&inner, reinterpret_cast<uint16_t *>(&out[0]), out.size());
+            out.resize(r.written);
+            return out;
+        }
+
+        std::u32string to_utf32() const
+        {
+            std::u32string out(::zstr_count_runes(&inner), U'\0');
+            ::zstr_transcode_result r = ::zstr_to_utf32(&inner, reinterpret_cast<uint32_t *>(&out[0]), out.size());
+            out.resize(r.written);
+            return out;
+        }
+
+        // Splitting.
+        // Usage: for(auto part : str.split(",")) { ... }
+        split_iterable split(const char *delim) const &
+        {
+            return split_iterable(::zstr_as_view(&inner), delim);
+        }
+
+        split_iterable split(const char *delim) const && = delete;
+
+#       if defined(ZSTR_HAS_POSIX)
+        // Writes the whole string to a blocking fd. Returns false on error (see errno).
+        bool write_to(int fd) const { return ::zstr_write_zstrs(fd, &inner, 1) == Z_OK; }
+#       endif
+
+        // Static Factories.
+        static string from_file(const char *path) 
+        {
+            string s;
+            s.inner = ::zstr_read_file(path);
+            return s;
+        }
+
+        // Builds a UTF-8 string from UTF-16 / UTF-32. Empty if the input is invalid.
+        static string from_utf16(const char16_t *p, size_t n)
+        {
+            string s;
+            ::zstr_cat_utf16(&s.inner, reinterpret_cast<const uint16_t *>(p), n);
+            return s;
+        }
+
+        static string from_utf32(const char32_t *p, size_t n)
+        {
+            string s;
+            ::zstr_cat_utf32(&s.inner, reinterpret_cast<const uint32_t *>(p), n);
+            return s;
+        }
+
+#       if defined(ZSTR_HAS_POSIX)
+        // Reads everything left in `fd` (pipes, sockets, /proc files). Empty on failure.
+        static string from_fd(int fd)
+        {
+            string s;
+            if (::zstr_read_fd(&s.inner, fd) != Z_OK) ::zstr_free(&s.inner);
+            return s;
+        }
+#       endif
+
+        // WARNING: Only POD types (int, double, char*) are safe here.
+        // Passing std::string or objects will crash.
+        template <typename... Args>
+        static string fmt(const char *format, Args... args)
+        {
+            string s;
+            ::zstr_fmt(&s.inner, format, args...);
+            return s;
+        }
+    };
+
+    // View constructor implementation.
+    inline view::view(const string &s) : inner(::zstr_as_view(&s.inner)) {}
+
+    class match_iterable
+    {
+        const ::zstr_searcher *sr;
+        ::zstr_view source;
+     public:
+        match_iterable(const ::zstr_searcher *s, ::zstr_view src) : sr(s), source(src) {}
+
+        struct iterator
+        {
+            using iterator_category = std::input_iterator_tag;
+            using value_type        = size_t;
+            using difference_type   = std::ptrdiff_t;
+            using pointer           = const size_t*;
+            using reference         = const size_t&;
+
+            ::zstr_search_iter state;
+            size_t current;
+            bool done;
+
+            iterator(const ::zstr_searcher *s, ::zstr_view src, bool end) : current(0), done(end)
+            {
+                if (!end)
+                {
+                    state = ::zstr_searcher_iter(s, src);
+                    next();
+                }
+            }
+
+            void next()
+            {
+                if (!::zstr_search_next(&state, &current))
+                {
+                    done = true;
+                }
+            }
+
+            size_t operator*() const { return current; }
+            iterator& operator++() { next(); return *this; }
+            bool operator!=(const iterator& other) const { return done != other.done; }
+            bool operator==(const iterator& other) const { return done == other.done; }
+        };
+
+        iterator begin() const { return iterator(sr, source, false); }
+        iterator end() const   { return iterator(sr, source, true); }
+    };
+
+    // Immutable reference-counted string. Copies are O(1) and share the bytes.
+    class shared
+    {
+        ::zstr_shared inner;
+
+     public:
+        shared() : inner(::zstr_shared_init()) {}
+        shared(const char *s) : inner(::zstr_shared_from(s)) {}
+        shared(view v) : inner(::zstr_shared_from_len(v.data(), v.size())) {}
+        shared(const string &s) : inner(::zstr_share(&s.inner)) {}
+
+        shared(const shared &other) : inner(::zstr_shared_retain(other.inner)) {}
+        shared(shared &&other) noexcept : inner(other.inner) { other.inner = ::zstr_shared_init(); }
+
+        ~shared() { ::zstr_shared_release(&inner); }
+
+        shared& operator=(const shared &other)
+        {
+            ::zstr_shared tmp = ::zstr_shared_retain(other.inner);
+            ::zstr_shared_release(&inner);
+            inner = tmp;
+            return *this;
+        }
+
+        shared& operator=(shared &&other) noexcept
+        {
+            if (this != &other)
+            {
+                ::zstr_shared_release(&inner);
+                inner = other.inner;
+                other.inner = ::zstr_shared_init();
+            }
+            return *this;
+        }
+
+        const char *c_str() const { return ::zstr_shared_cstr(inner); }
+        const char *data() const  { return ::zstr_shared_cstr(inner); }
+        size_t size() const       { return ::zstr_shared_len(inner); }
+        bool empty() const        { return size() == 0; }
+        size_t use_count() const  { return ::zstr_shared_refcount(inner); }
+
+        // Borrowed view, valid while any copy of this string lives.
+        operator view() const & { return view(data(), size()); }
+        operator view() const && = delete;
+
+        // Copy-on-write: gives up this reference and returns a mutable string.
+        // Reuses the buffer without copying when this was the only reference.
+        string promote()
+        {
+            string s;
+            s.inner = ::zstr_shared_promote(&inner);
+            return s;
+        }
+    };
+
+    // Chunked builder for very large strings. Copies share chunks instead of bytes.
+    // Usage: for (z_str::view part : r) write(fd, part.data(), part.size());
+    class rope
+    {
+        ::zstr_rope inner;
+
+     public:
+        class iterator
+        {
+            const ::zstr_rope *r;
+            size_t i;
+
+         public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type        = view;
+            using difference_type   = std::ptrdiff_t;
+            using pointer           = const view*;
+            using reference         = view;
+
+            iterator(const ::zstr_rope *rp, size_t idx) : r(rp), i(idx) {}
+
+            view operator*() const
+            {
+                ::zstr_view v = ::zstr_rope_chunk(r, i);
+                return view(v.data, v.len);
+            }
+
+            iterator& operator++() { i++; return *this; }
+            iterator operator++(int) { iterator tmp = *this; i++; return tmp; }
+
+            bool operator==(const iterator &other) const { return i == other.i; }
+            bool operator!=(const iterator &other) const { return i != other.i; }
+        };
+
+        rope() : inner(::zstr_rope_init()) {}
+        rope(const rope &other) : inner(::zstr_rope_init()) { append(other); }
+        rope(rope &&other) noexcept : inner(other.inner) { other.inner = ::zstr_rope_init(); }
+        ~rope() { ::zstr_rope_free(&inner); }
+
+        rope& operator=(const rope &other)
+        {
+            if (this != &other)
+            {
+                ::zstr_rope_clear(&inner);
+                append(other);
+            }
+            return *this;
+        }
+
+        rope& operator=(rope &&other) noexcept
+        {
+            if (this != &other)
+            {
+                ::zstr_rope_free(&inner);
+                inner = other.inner;
+                other.inner = ::zstr_rope_init();
+            }
+            return *this;
+        }
+
+        rope& append(view v)          { ::zstr_rope_append_len(&inner, v.data(), v.size()); return *this; }
+        rope& append(const rope &other) { ::zstr_rope_append_rope(&inner, &other.inner); return *this; }
+
+        // Borrows `v` without copying; the bytes must outlive this rope.
+        rope& append_ref(view v)      { ::zstr_rope_append_ref(&inner, ::zstr_view{v.data(), v.size()}); return *this; }
 
-#       if __cplusplus >= 201703L
-        operator std::string_view() const { return std::string_view(data(), size()); }
-#       endif
+        rope& operator+=(view v)           { return append(v); }
+        rope& operator+=(const char *s)    { return append(view(s)); }
+        rope& operator+=(const string &s)  { return append(view(s)); }
+        rope& operator+=(const rope &other) { return append(other); }
 
-        bool starts_with(const char *prefix) const { return ::zstr_view_starts_with(inner, prefix); }
-        bool ends_with(const char *suffix) const   { return ::zstr_view_ends_with(inner, suffix); }
-        bool equals(const char *str) const         { return ::zstr_view_eq(inner, str); }
+        size_t size() const         { return ::zstr_rope_len(&inner); }
+        bool empty() const          { return size() == 0; }
+        void clear()                { ::zstr_rope_clear(&inner); }
+        char operator[](size_t idx) const { return ::zstr_rope_at(&inner, idx); }
 
-        view sub(size_t start, size_t len) const
+        size_t chunk_count() const  { return ::zstr_rope_chunk_count(&inner); }
+        view chunk(size_t i) const
         {
-            ::zstr_view v = ::zstr_sub(inner, start, len);
+            ::zstr_view v = ::zstr_rope_chunk(&inner, i);
             return view(v.data, v.len);
         }
 
-        view lstrip() const
+        iterator begin() const { return iterator(&inner, 0); }
+        iterator end() const   { return iterator(&inner, chunk_count()); }
+
+        // Shares the chunks covering [start, start + len) (clamped).
+        rope slice(size_t start, size_t len) const
         {
-            ::zstr_view v = ::zstr_view_lstrip(inner);
-            return view(v.data, v.len);
+            rope out;
+            ::zstr_rope_slice(&inner, start, len, &out.inner);
+            return out;
         }
 
-        view rstrip() const
+        string flatten() const
         {
-            ::zstr_view v = ::zstr_view_rstrip(inner);
-            return view(v.data, v.len);
+            string s;
+            ::zstr_cat_rope(&s.inner, &inner);
+            return s;
         }
 
-        view trim() const
+#       if defined(ZSTR_HAS_POSIX)
+        // Writes every piece with writev (blocking fd). Returns false on error (see errno).
+        bool write_to(int fd) const { return ::zstr_write_rope(fd, &inner) == Z_OK; }
+#       endif
+
+        const ::zstr_rope *c_rope() const { return &inner; }
+    };
+
+#   if defined(ZSTR_HAS_POSIX)
+    // Read-only mapping of a file, unmapped by the destructor.
+    // Usage: z_str::mapped_file f("big.log"); if (f) lines = f.text().split_count("\n");
+    class mapped_file
+    {
+        ::zstr_mmap inner;
+        bool ok;
+
+     public:
+        explicit mapped_file(const char *path, int advice = ZSTR_MMAP_SEQUENTIAL)
         {
-            ::zstr_view v = ::zstr_view_trim(inner);
-            return view(v.data, v.len);
+            ok = ::zstr_mmap_file(&inner, path, advice) == Z_OK;
         }
 
-        // Returns true if parsing was successful.
-        bool to_int(int *out) const { return ::zstr_view_to_int(inner, out); }
+        mapped_file(mapped_file &&other) noexcept : inner(other.inner), ok(other.ok)
+        {
+            other.inner.data = "";
+            other.inner.len = 0;
+            other.ok = false;
+        }
 
-        // Comparisons.
-        bool operator==(const char* other) const { return ::zstr_view_eq(inner, other); }
-        bool operator==(const view& other) const { return ::zstr_view_eq_view(inner, other.inner); }
-        bool operator!=(const char* other) const { return !(*this == other); }
-        bool operator!=(const view& other) const { return !(*this == other); }
+        ~mapped_file() { ::zstr_mmap_free(&inner); }
+
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        // False if the file could not be opened or mapped (see errno).
+        bool is_open() const        { return ok; }
+        explicit operator bool() const { return ok; }
+
+        const char *data() const    { return inner.data; }
+        size_t size() const         { return inner.len; }
+
+        // Borrowed view of the bytes, valid while this object lives.
+        view text() const           { return view(inner.data, inner.len); }
+
+        void advise(int advice) const { ::zstr_mmap_advise(&inner, advice); }
     };
+#   endif
 
-    class split_iterable
+#   if defined(ZSTR_HAS_POSIX)
+    // Streaming line reader over a file descriptor (the fd is not closed).
+    // Usage: for (z_str::view line : z_str::line_reader(fd)) { ... }
+    // Each view is valid until the loop advances.
+    class line_reader
     {
-        ::zstr_view source;
-        const char *delim;
-     public:
-        split_iterable(::zstr_view s, const char *d) : source(s), delim(d) {}
+        ::zstr_line_reader inner;
 
-        struct iterator 
+     public:
+        class iterator
         {
+            ::zstr_line_reader *r;
+            view line;
+
+            void advance()
+            {
+                ::zstr_view v;
+                if (r && ::zstr_line_reader_next(r, &v)) line = view(v.data, v.len);
+                else r = NULL;
+            }
+
+         public:
             using iterator_category = std::input_iterator_tag;
             using value_type        = view;
             using difference_type   = std::ptrdiff_t;
             using pointer           = const view*;
             using reference         = const view&;
 
-            ::zstr_split_iter state;
-            ::zstr_view current_part;
-            bool done;
-
-            iterator(::zstr_view s, const char *d, bool end) : done(end)
-            {
-                if (!end)
-                {
-                    state = ::zstr_split_init(s, d);
-                    next();
-                }
-            }
+            explicit iterator(::zstr_line_reader *reader) : r(reader) { advance(); }
 
-            void next() 
-            {
-                if (!::zstr_split_next(&state, &current_part))
-                {
-                    done = true;
-                }
-            }
+            const view& operator*() const { return line; }
+            iterator& operator++() { advance(); return *this; }
 
-            view operator*() const { return view(current_part.data, current_part.len); }
-            iterator& operator++() { next(); return *this; }
-            bool operator!=(const iterator& other) const { return done != other.done; }
-            bool operator==(const iterator& other) const { return done == other.done; }
+            bool operator==(const iterator &other) const { return r == other.r; }
+            bool operator!=(const iterator &other) const { return r != other.r; }
         };
 
-        iterator begin() { return iterator(source, delim, false); }
-        iterator end()   { return iterator(source, delim, true); }
+        // Throws std::bad_alloc if the read buffer cannot be allocated.
+        explicit line_reader(int fd, size_t block_size = 0)
+        {
+            if (::zstr_line_reader_init(&inner, fd, block_size) != Z_OK) ZSTR__THROW_BAD_ALLOC();
+        }
+        ~line_reader() { ::zstr_line_reader_free(&inner); }
+
+        line_reader(const line_reader&) = delete;
+        line_reader& operator=(const line_reader&) = delete;
+
+        // Single pass: begin() continues from wherever the reader stopped.
+        iterator begin() { return iterator(&inner); }
+        iterator end()   { return iterator(NULL); }
+
+        bool next(view &line)
+        {
+            ::zstr_view v;
+            if (!::zstr_line_reader_next(&inner, &v)) return false;
+            line = view(v.data, v.len);
+            return true;
+        }
+
+        // errno of the last failed read (0 at a clean end of input).
+        int error() const { return ::zstr_line_reader_error(&inner); }
     };
+#   endif
 
-    class string
+    // Sparse rune -> byte offset index over a string (every ZSTR_RUNE_INDEX_STRIDE runes).
+    // The string must outlive the index. Call update() after appending, or
+    // rebuild() after any other edit.
+    class rune_index
     {
-        ::zstr inner;
-        friend class view;
-
-        friend bool operator==(const string& lhs, const string& rhs);
-        friend bool operator!=(const string& lhs, const string& rhs);
-        friend bool operator<(const string& lhs, const string& rhs);
+        ::zstr_rune_index inner;
+        const string *str;
 
      public:
-        // Iterator traits.
-        using value_type      = char;
-        using size_type       = size_t;
-        using difference_type = std::ptrdiff_t;
-        using pointer         = char*;
-        using const_pointer   = const char*;
-        using iterator        = char*;
-        using const_iterator  = const char*;
+        explicit rune_index(const string &s) : str(&s)
+        {
+            ::zstr_rune_index_init(&inner);
+            ::zstr_rune_index_build(&inner, &s.inner);
+        }
 
-        // Default constructor.
-        string() : inner(::zstr_init()) {}
+        rune_index(rune_index &&other) noexcept : inner(other.inner), str(other.str)
+        {
+            ::zstr_rune_index_init(&other.inner);
+        }
 
-        // C-string constructor.
-        string(const char *s) : inner(::zstr_from(s)) {}
+        ~rune_index() { ::zstr_rune_index_free(&inner); }
 
-        // Length constructor.
-        string(const char *s, size_t len) : inner(::zstr_from_len(s, len)) {}
+        rune_index(const rune_index&) = delete;
+        rune_index& operator=(const rune_index&) = delete;
 
-        // This one is for C++17 so we put it like this.
-#       if __cplusplus >= 201703L
-        string(std::string_view sv) : inner(::zstr_from_len(sv.data(), sv.size())) {}
-#       endif
+        void update()  { ::zstr_rune_index_update(&inner, &str->inner); }
+        void rebuild() { ::zstr_rune_index_build(&inner, &str->inner); }
 
-        // Copy constructor.
-        string(const string &other) : inner(::zstr_dup(&other.inner)) {}
+        // Number of runes.
+        size_t size() const { return ::zstr_rune_index_len(&inner); }
 
-        // Move constructor (zero cost).
-        string(string &&other) noexcept : inner(other.inner) 
+        // Byte offset of a rune, and the rune holding a byte.
+        size_t offset(size_t rune) const  { return ::zstr_rune_index_offset(&inner, &str->inner, rune); }
+        size_t rune_at(size_t byte) const { return ::zstr_rune_index_rune_at(&inner, &str->inner, byte); }
+
+        // Slice of `len` runes from rune `start` (clamped).
+        view sub(size_t start, size_t len) const
         {
-        other.inner = ::zstr_init();
+            ::zstr_view v = ::zstr_rune_index_sub(&inner, &str->inner, start, len);
+            return view(v.data, v.len);
         }
+    };
 
-        // Destructor.
-        ~string() { ::zstr_free(&inner); }
+    // Precompiled needle for repeated searches. Owns a copy of the needle.
+    class searcher
+    {
+        string needle;
+        ::zstr_searcher inner;
 
-        // Copy assignment.
-        string& operator=(const string &other)
+        void rebind() { inner.needle = ::zstr_as_view(&needle.inner); }
+
+     public:
+        explicit searcher(view n) : needle(n.data(), n.size())
         {
-            if (this != &other)
-            {
-                ::zstr_free(&inner);
-                inner = ::zstr_dup(&other.inner);
-            }
-            return *this;
+            inner = ::zstr_searcher_init(::zstr_as_view(&needle.inner));
         }
 
-        // Move assignment (transfer ownership).
-        string& operator=(string &&other) noexcept
+        // Copies reuse the compiled tables and only rebind the needle bytes.
+        searcher(const searcher &other) : needle(other.needle), inner(other.inner) { rebind(); }
+
+        searcher& operator=(const searcher &other)
         {
             if (this != &other)
             {
-                ::zstr_free(&inner);
+                needle = other.needle;
                 inner = other.inner;
-                other.inner = ::zstr_init();
+                rebind();
             }
             return *this;
         }
 
-        // Assignment from C-string.
-        string& operator=(const char *s)
+        view pattern() const { return view(needle); }
+
+        std::ptrdiff_t find(view hay) const
         {
-            ::zstr_free(&inner);
-            inner = ::zstr_from(s);
-            return *this;
+            return ::zstr_searcher_find(&inner, ::zstr_view{hay.data(), hay.size()});
         }
 
-        // Accessors.
-        const char *c_str() const { return ::zstr_cstr(&inner); }
-        const char *data() const  { return ::zstr_cstr(&inner); }
-        char *data()              { return ::zstr_data(&inner); }
-        size_t size() const       { return ::zstr_len(&inner); }
-        size_t length() const     { return ::zstr_len(&inner); }
-        size_t capacity() const   { return inner.is_long ? inner.l.cap : ZSTR_SSO_CAP; }
-        bool is_empty() const     { return ::zstr_is_empty(&inner); }
-
-#       if __cplusplus >= 201703L
-        operator std::string_view() const { return std::string_view(data(), size()); }
-#       endif
+        std::ptrdiff_t find(view hay, size_t from) const
+        {
+            return ::zstr_searcher_find_from(&inner, ::zstr_view{hay.data(), hay.size()}, from);
+        }
 
-        // Iterators.
-        char *begin()             { return ::zstr_data(&inner); }
-        char *end()               { return ::zstr_data(&inner) + size(); }
-        const char *begin() const { return ::zstr_cstr(&inner); }
-        const char *end() const   { return ::zstr_cstr(&inner) + size(); }
+        bool contains(view hay) const { return find(hay) != -1; }
 
-        char& operator[](size_t idx)             { return ::zstr_data(&inner)[idx]; }
-        const char& operator[](size_t idx) const { return ::zstr_cstr(&inner)[idx]; }
+        // Usage: for (size_t pos : s.find_all(text)) { ... }
+        match_iterable find_all(view hay) const &
+        {
+            return match_iterable(&inner, ::zstr_view{hay.data(), hay.size()});
+        }
 
-        char& front()             { return operator[](0); }
-        const char& front() const { return operator[](0); }
-        
-        char& back()              { return operator[](size() - 1); }
-        const char& back() const  { return operator[](size() - 1); }
+        match_iterable find_all(view hay) const && = delete;
+    };
 
-        // Modifiers.
-        void clear()             { ::zstr_clear(&inner); }
-        void reserve(size_t cap) { ::zstr_reserve(&inner, cap); }
-        void shrink_to_fit()     { ::zstr_shrink_to_fit(&inner); }
-        
-        void push_back(char c) { ::zstr_push_char(&inner, c); }
-        void pop_back()        { ::zstr_pop_char(&inner); }
-        
-        string& append(const char *s)             { ::zstr_cat(&inner, s); return *this; }
-        string& append(const char *s, size_t len) { ::zstr_cat_len(&inner, s, len); return *this; }
+    // Canonical handle returned by an interner: equality is an id compare.
+    class interned
+    {
+        ::zstr_interned inner;
 
-        // Operators.
-        string& operator+=(const char *s)       { return append(s); }
-        string& operator+=(char c)              { push_back(c); return *this; }
-        string& operator+=(const string &other) { return append(other.c_str(), other.size()); }
+     public:
+        interned() { inner.view.data = NULL; inner.view.len = 0; inner.id = 0; }
+        interned(const ::zstr_interned &h) : inner(h) {}
 
-        // Search
-        std::ptrdiff_t find(const char *needle) const { return ::zstr_find(&inner, needle); }
-        bool contains(const char *needle) const       { return ::zstr_contains(&inner, needle); }
-        bool starts_with(const char *prefix) const    { return ::zstr_starts_with(&inner, prefix); }
-        bool ends_with(const char *suffix) const      { return ::zstr_ends_with(&inner, suffix); }
+        uint32_t id() const         { return inner.id; }
+        view text() const           { return view(inner.view.data, inner.view.len); }
+        const char *c_str() const   { return inner.view.data; }
+        size_t size() const         { return inner.view.len; }
+        explicit operator bool() const { return inner.id != 0; }
 
-        // Some utilities.
-        void to_lower() { ::zstr_to_lower(&inner); }
-        void to_upper() { ::zstr_to_upper(&inner); }
-        void trim()     { ::zstr_trim(&inner); }
+        bool operator==(const interned &other) const { return inner.id == other.inner.id; }
+        bool operator!=(const interned &other) const { return inner.id != other.inner.id; }
+    };
 
-        void replace(const char *target, const char *replacement) 
-        {
-            ::zstr_replace(&inner, target, replacement);
-        }
+    // String interning pool. Pass shards > 0 for a thread-safe, sharded pool.
+    class interner
+    {
+        ::zstr_intern inner;
 
-        // Ownership.
-        // WARNING: Returns a raw malloc'd pointer. You MUST free() this yourself.
-        // The string object becomes empty after this call.
-        char* release() { return ::zstr_take(&inner); }
+     public:
+        explicit interner(size_t shards = 0) { ::zstr_intern_init(&inner, shards); }
+        ~interner() { ::zstr_intern_free(&inner); }
 
-        static string own(char *ptr, size_t len, size_t cap) 
-        {
-            string s;
-            s.inner = ::zstr_own(ptr, len, cap);
-            return s;
-        }
+        interner(const interner&) = delete;
+        interner& operator=(const interner&) = delete;
 
-        // UTF-8.
-        size_t rune_count() const    { return ::zstr_count_runes(&inner); }
-        bool is_valid_utf8() const   { return ::zstr_is_valid_utf8(&inner); }
+        interned intern(view v) { return interned(::zstr_intern_view(&inner, ::zstr_view{v.data(), v.size()})); }
+        interned find(view v)   { return interned(::zstr_intern_find(&inner, ::zstr_view{v.data(), v.size()})); }
+        view get(uint32_t id)   { ::zstr_view v = ::zstr_intern_get(&inner, id); return view(v.data, v.len); }
 
-        // Splitting.
-        // Usage: for(auto part : str.split(",")) { ... }
-        split_iterable split(const char *delim) const &
+        // Interns `n` views into `out`. Returns false if any allocation failed.
+        bool intern_bulk(const view *in, size_t n, interned *out)
         {
-            return split_iterable(::zstr_as_view(&inner), delim);
+            static_assert(sizeof(interned) == sizeof(::zstr_interned), "interned must wrap zstr_interned");
+            return ::zstr_intern_bulk(&inner, reinterpret_cast<const ::zstr_view*>(in), n,
+                                      reinterpret_cast<::zstr_interned*>(out)) == Z_OK;
         }
 
-        split_iterable split(const char *delim) const && = delete;
+        ::zstr_intern_stats stats() { return ::zstr_intern_stats_get(&inner); }
+    };
 
-        // Static Factories.
-        static string from_file(const char *path) 
-        {
-            string s;
-            s.inner = ::zstr_read_file(path);
-            return s;
-        }
+    // Routes strings created on this thread to allocator `id` until the scope ends.
+    // Usage: { z_str::allocator_scope pool(pool_id); z_str::string s("..."); }
+    class allocator_scope
+    {
+        int prev;
 
-        // WARNING: Only POD types (int, double, char*) are safe here.
-        // Passing std::string or objects will crash.
-        template <typename... Args>
-        static string fmt(const char *format, Args... args)
-        {
-            string s;
-            ::zstr_fmt(&s.inner, format, args...);
-            return s;
-        }
-    };
+     public:
+        explicit allocator_scope(int id) : prev(::zstr_allocator_use(id)) {}
+        ~allocator_scope() { if (prev >= 0) ::zstr_allocator_use(prev); }
 
-    // View constructor implementation.
-    inline view::view(const string &s) : inner(::zstr_as_view(&s.inner)) {}
+        allocator_scope(const allocator_scope&) = delete;
+        allocator_scope& operator=(const allocator_scope&) = delete;
+    };
 
     // The global operators...
     inline std::ostream& operator<<(std::ostream &os, const string &s)
@@ -1455,6 +7545,22 @@ namespace z_str
     inline bool operator!=(const char* lhs, const string& rhs) { return strcmp(lhs, rhs.c_str()) != 0; }
 }
 
+// Hash support so z_str::string / z_str::view work as std::unordered_map keys.
+namespace std
+{
+    template <>
+    struct hash<z_str::string>
+    {
+        size_t operator()(const z_str::string &s) const noexcept { return (size_t)s.hash(); }
+    };
+
+    template <>
+    struct hash<z_str::view>
+    {
+        size_t operator()(const z_str::view &v) const noexcept { return (size_t)v.hash(); }
+    };
+}
+
 #endif  // __cplusplus
 
 #endif  // ZSTR_H